@@ -5,39 +5,44 @@
 #include <bpf/bpf_helpers.h>
 #include <bpf/bpf_core_read.h>
 #include <stdbool.h>
+#include "tmt_events.h"
 
 #ifndef TASK_COMM_LEN
 #define TASK_COMM_LEN 16
 #endif
 
-struct data_t {
-    __u32 parent_pid;
-    __u32 pid;
-    __u32 child_pid;     // ->! 0 on execve
-    __u32 pgid;        
-    __u32 tid;
-    __u32 tgid;
-    char  command[TASK_COMM_LEN];
-    __u64 timestamp;     // ns
-};
+static __always_inline __u32 cfg_get(void *cfg_map, __u32 key)
+{
+    __u32 *val = bpf_map_lookup_elem(cfg_map, &key);
+    return val ? *val : 0;
+}
 
 static __always_inline int producer_enabled(void *cfg_map)
 {
-    /* 0: 1 => enabled, else disabled */
-    __u32 key = 0;
-    __u32 *val = bpf_map_lookup_elem(cfg_map, &key);
-    return val && (*val == 1);
+    /* TMT_CFG_ENABLED: 1 => enabled, else disabled */
+    return cfg_get(cfg_map, TMT_CFG_ENABLED) == 1;
 }
 
-static __always_inline void inc_ev_count(void *ev_percpu_arr)
+static __always_inline void inc_ev_count(void *ev_percpu_arr, __u32 kind)
 {
-    __u32 key = 0;
-    __u64 *cnt = bpf_map_lookup_elem(ev_percpu_arr, &key);
+    __u64 *cnt = bpf_map_lookup_elem(ev_percpu_arr, &kind);
     if (cnt) {
         __sync_fetch_and_add(cnt, 1);
     }
 }
 
+/* submit flags: without a threshold every record wakes the consumer,
+ * otherwise only the record that takes the unread data past it does;
+ * the consumer poll timeout picks up whatever stays below */
+static __always_inline __u64 rb_wakeup_flags(void *cfg_map, void *rb)
+{
+    __u32 thresh = cfg_get(cfg_map, TMT_CFG_WAKEUP_BYTES);
+    if (!thresh)
+        return 0;
+    return bpf_ringbuf_query(rb, BPF_RB_AVAIL_DATA) >= thresh ? BPF_RB_FORCE_WAKEUP
+                                                               : BPF_RB_NO_WAKEUP;
+}
+
 static __always_inline void fill_task_data(struct data_t *d)
 {
     struct task_struct *task = (struct task_struct *)bpf_get_current_task_btf();
@@ -60,6 +65,7 @@ static __always_inline void fill_task_data(struct data_t *d)
     bpf_get_current_comm(&d->command, sizeof(d->command));
     d->timestamp = bpf_ktime_get_ns();
     d->child_pid = 0;  
+    d->hdr.cpu = bpf_get_smp_processor_id();
 }
 
 #endif
@@ -0,0 +1,130 @@
+#ifndef TMT_EVENTS_H
+#define TMT_EVENTS_H
+
+/* Wire format shared by the BPF programs and userspace */
+
+#ifndef __VMLINUX_H__
+#include <linux/types.h>
+#endif
+
+#define TMT_COMM_LEN 16
+
+/* bumped whenever a record layout changes */
+#define TMT_WIRE_VERSION 3
+
+/* record kinds, carried in tmt_event_hdr.kind (also ev_count keys) */
+enum tmt_event_kind {
+    TMT_EV_NONE = 0,
+    TMT_EV_EXECVE_ENTER,
+    TMT_EV_EXECVE_EXIT,
+    TMT_EV_FORK,
+    TMT_EV_CLONE,
+    TMT_EV_CLONE3,
+    TMT_EV_EXIT,
+    TMT_EV_EXIT_GROUP,
+    TMT_EV_SWITCH,
+    TMT_EV_SLICE,
+    TMT_EV_COMM,
+    TMT_EV_MAX,
+};
+
+/* keys of the cfg array map */
+enum tmt_cfg_key {
+    TMT_CFG_ENABLED = 0,        // 1 => producers enabled
+    TMT_CFG_USE_FILTER,         // 1 => probes only emit for tids in allow_pids
+    TMT_CFG_SWITCH_MODE,        // enum tmt_switch_mode
+    TMT_CFG_WAKEUP_BYTES,       // wake the consumer once this much is unread, 0 => every record
+    TMT_CFG_RINGS,              // > 0 => CPU c writes to cpu_rings[c % n] instead of events
+    TMT_CFG_MAX,
+};
+
+/* values of allow_pids */
+enum tmt_allow_state {
+    TMT_ALLOW_TRACED = 1,
+    TMT_ALLOW_EXITING,          // past sched_process_exit, dropped at its last switch-out
+};
+
+/* keys of the filter_stats per-CPU array */
+enum tmt_filter_stat {
+    TMT_FILTER_ADDED = 0,       // children added by handle_sched_fork
+    TMT_FILTER_FULL,            // children not added, allow_pids was full
+    TMT_FILTER_REMOVED,         // exited tids dropped
+    TMT_FILTER_MAX,
+};
+
+/* what trace_sched_switch does with each context switch */
+enum tmt_switch_mode {
+    TMT_SWITCH_EVENTS = 0,      // stream run/desched records
+    TMT_SWITCH_SUMMARY,         // aggregate into rt_stats, stream nothing
+    TMT_SWITCH_SLICES,          // one slice_event_t per switch-out
+};
+
+/* first member of every record in the shared ring buffer */
+struct tmt_event_hdr {
+    __u8  kind;
+    __u8  version;              // TMT_WIRE_VERSION
+    __u16 cpu;
+    __u32 seq;                  // per-CPU, bumped on every reserve attempt
+};
+
+/* process lifecycle events (execve, fork, clone, exit, ...) */
+struct data_t {
+    struct tmt_event_hdr hdr;
+    __u32 parent_pid;
+    __u32 pid;
+    __u32 child_pid;     // ->! 0 on execve
+    __u32 pgid;
+    __u32 tid;
+    __u32 tgid;
+    char  command[TMT_COMM_LEN];
+    __u64 timestamp;     // ns
+};
+
+/* switch records pack the tid with flag bits (pid_max <= 2^22) */
+#define TMT_SW_TID_MASK  0x3fffffffu
+#define TMT_SW_IN        (1u << 30)     // switch-in, else switch-out
+#define TMT_SW_BLOCKED   (1u << 31)     // switch-out asleep, not preempted
+
+/* sched_switch events; the comm of a tid comes in comm_event_t */
+struct switch_event_t {
+    struct tmt_event_hdr hdr;                   // hdr.cpu: CPU id
+    __u32 tid_flags;                            // tid | TMT_SW_IN | TMT_SW_BLOCKED
+    __u32 pad;
+    __u64 ts;                                   // ns
+};
+
+/* completed on-CPU slice, emitted at switch-out (TMT_SWITCH_SLICES) */
+struct slice_event_t {
+    struct tmt_event_hdr hdr;                   // hdr.cpu: CPU id
+    __u32 tid_flags;                            // tid | TMT_SW_BLOCKED
+    __u32 pad;
+    __u64 start;                                // ns, 0 if the switch-in was not seen
+    __u64 end;                                  // ns
+};
+
+/* comm of a tid, sent before its first switch record and when it changes */
+struct comm_event_t {
+    struct tmt_event_hdr hdr;
+    __u32 tid;
+    __u32 pad;
+    char  comm[TMT_COMM_LEN];
+};
+
+/* --summary: rt_stats value, one copy per CPU for each tid */
+struct tmt_rt_stat {
+    __u64 oncpu_ns;
+    __u64 switches;
+    __u64 voluntary;            // switched out asleep (prev_state set, not preempted)
+    __u64 involuntary;          // switched out runnable (prev_state 0 or TASK_REPORT_MAX)
+    char  comm[TMT_COMM_LEN];
+};
+
+/* task switched in on this CPU (cpu_run value), --summary and slices */
+struct tmt_cpu_run {
+    __u64 ts;                   // 0 => nothing tracked
+    __u32 tid;
+    __u32 pad;
+    char  comm[TMT_COMM_LEN];   // next_comm at switch-in
+};
+
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+#include <cstdint>
+#include <cstddef>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+/* Process-wide intern table for task comm names.
+ * Id 0 is always the empty name. */
+class CommTable {
+public:
+    static CommTable& instance();
+
+    uint32_t intern(const char* comm, size_t maxlen = 16);
+    uint32_t intern(const std::string& comm);
+    const std::string& name(uint32_t id) const;
+    size_t size() const;
+
+private:
+    CommTable();
+
+    mutable std::mutex mtx_;
+    std::unordered_map<std::string, uint32_t> ids_;
+    std::deque<std::string> names_;   // deque keeps references stable
+};
+
+inline const std::string& comm_name(uint32_t id) {
+    return CommTable::instance().name(id);
+}
@@ -0,0 +1,127 @@
+#pragma once
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/* Growable text buffer; integers are formatted with std::to_chars. */
+class CsvBuffer {
+public:
+    CsvBuffer& put(char c) {
+        reserve(1);
+        buf_[len_++] = c;
+        return *this;
+    }
+    CsvBuffer& put(std::string_view s) {
+        reserve(s.size());
+        s.copy(buf_.data() + len_, s.size());
+        len_ += s.size();
+        return *this;
+    }
+    CsvBuffer& put(const char* s) { return put(std::string_view(s)); }
+    CsvBuffer& put(const std::string& s) { return put(std::string_view(s)); }
+
+    template <class T, class = std::enable_if_t<std::is_integral_v<T> &&
+                                                !std::is_same_v<T, char> &&
+                                                !std::is_same_v<T, bool>>>
+    CsvBuffer& put(T v) {
+        reserve(24);
+        auto r = std::to_chars(buf_.data() + len_, buf_.data() + buf_.size(), v);
+        len_ = r.ptr - buf_.data();
+        return *this;
+    }
+
+    const char* data() const { return buf_.data(); }
+    size_t size() const { return len_; }
+    void clear() { len_ = 0; }
+
+private:
+    void reserve(size_t n) {
+        if (len_ + n > buf_.size()) buf_.resize(std::max(buf_.size() * 2, len_ + n + 4096));
+    }
+
+    std::vector<char> buf_;
+    size_t len_{0};
+};
+
+/* Buffered CSV (or any text) output: rows are formatted into a large
+ * buffer that goes to the file with write(2) once it fills up.
+ * write_rows() can format blocks of rows on several threads; the bytes
+ * written are the same as formatting them one by one. */
+class CsvWriter {
+public:
+    explicit CsvWriter(size_t flush_bytes = 1 << 20);
+    ~CsvWriter();
+
+    CsvWriter(const CsvWriter&) = delete;
+    CsvWriter& operator=(const CsvWriter&) = delete;
+
+    bool open(const std::string& path);
+    bool is_open() const { return fd_ >= 0; }
+    /* false if any write failed */
+    bool close();
+
+    template <class T>
+    CsvWriter& put(const T& v) {
+        buf_.put(v);
+        return *this;
+    }
+    /* ends the row with '\n', writing the buffer out if it is full */
+    void end_row() {
+        buf_.put('\n');
+        if (buf_.size() >= flush_bytes_) flush();
+    }
+
+    /* fmt(CsvBuffer&, const T&) formats one row including its '\n' */
+    template <class T, class Fn>
+    void write_rows(const T* rows, size_t n, Fn fmt, unsigned threads = 1);
+
+    void flush();
+
+private:
+    void write_out(const char* p, size_t n);
+
+    int fd_{-1};
+    std::string path_;
+    bool failed_{false};
+    size_t flush_bytes_;
+    CsvBuffer buf_;
+};
+
+template <class T, class Fn>
+void CsvWriter::write_rows(const T* rows, size_t n, Fn fmt, unsigned threads) {
+    const size_t BLOCK = 64 * 1024;
+    if (threads <= 1 || n < 2 * BLOCK) {
+        for (size_t i = 0; i < n; ++i) {
+            fmt(buf_, rows[i]);
+            if (buf_.size() >= flush_bytes_) flush();
+        }
+        return;
+    }
+
+    // one block per thread and round, written in order
+    flush();
+    std::vector<CsvBuffer> out(threads);
+    for (size_t base = 0; base < n; base += BLOCK * threads) {
+        std::vector<std::thread> workers;
+        for (unsigned t = 0; t < threads; ++t) {
+            size_t lo = base + t * BLOCK;
+            if (lo >= n) break;
+            size_t hi = std::min(n, lo + BLOCK);
+            workers.emplace_back([&, t, lo, hi]() {
+                out[t].clear();
+                for (size_t i = lo; i < hi; ++i) fmt(out[t], rows[i]);
+            });
+        }
+        for (size_t t = 0; t < workers.size(); ++t) {
+            workers[t].join();
+            write_out(out[t].data(), out[t].size());
+        }
+    }
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "common.hpp"
+
+struct EventChunk {
+    static constexpr size_t CAP = 4096;
+    Event ev[CAP];
+};
+
+/* Events appended by one thread at a time, in fixed-size chunks: no lock
+ * and no allocation per event. clear() keeps the chunks for reuse,
+ * reset() frees them. */
+class EventChunkList {
+public:
+    void push(const Event& e) {
+        if (fill_ == EventChunk::CAP) next_chunk();
+        chunks_[used_ - 1]->ev[fill_++] = e;
+    }
+
+    size_t size() const { return used_ ? (used_ - 1) * EventChunk::CAP + fill_ : 0; }
+    bool empty() const { return size() == 0; }
+
+    /* fn(const Event&) on every event, in push order */
+    template <typename Fn>
+    void for_each(Fn&& fn) const {
+        for (size_t c = 0; c < used_; ++c) {
+            size_t n = c + 1 == used_ ? fill_ : EventChunk::CAP;
+            for (size_t i = 0; i < n; ++i) fn(chunks_[c]->ev[i]);
+        }
+    }
+
+    void clear() { used_ = 0; fill_ = EventChunk::CAP; }
+    void reset() { chunks_.clear(); clear(); }
+
+private:
+    void next_chunk() {
+        if (used_ == chunks_.size()) chunks_.push_back(std::make_unique<EventChunk>());
+        ++used_;
+        fill_ = 0;
+    }
+
+    std::vector<std::unique_ptr<EventChunk>> chunks_;
+    size_t used_{0};                // chunks holding events
+    size_t fill_{EventChunk::CAP};  // events in the last of them
+};
@@ -0,0 +1,16 @@
+#pragma once
+#include "common.hpp"
+
+/* Receiver of decoded events, in the order the producer hands them over.
+ * on_begin/on_end bracket one stream; root_pid is the traced command and
+ * start_ns the kernel time tracing started, 0 if not known. */
+class EventSink {
+public:
+    virtual ~EventSink() = default;
+    virtual void on_begin(uint32_t root_pid, uint64_t start_ns) {
+        (void)root_pid;
+        (void)start_ns;
+    }
+    virtual void on_event(const Event& e) = 0;
+    virtual void on_end() {}
+};
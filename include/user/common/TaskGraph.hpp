@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ThreadPool.hpp"
+
+/* Tasks with dependencies, run on a ThreadPool: a task is submitted as
+ * soon as everything it depends on has finished. A task that throws is
+ * reported and counts as finished. */
+class TaskGraph {
+public:
+    using Id = size_t;
+
+    /* deps must already have been added */
+    Id add(std::string name, std::function<void()> fn, const std::vector<Id>& deps = {});
+    /* runs every task and returns once all have finished */
+    void run(ThreadPool& pool);
+
+    size_t size() const { return tasks_.size(); }
+
+private:
+    struct Task {
+        std::string name;
+        std::function<void()> fn;
+        std::vector<Id> next;
+        size_t waiting{0};
+    };
+
+    void start(ThreadPool& pool, Id id);
+
+    std::vector<Task> tasks_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    size_t done_{0};
+};
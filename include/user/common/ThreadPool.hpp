@@ -0,0 +1,30 @@
+#pragma once
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/* Fixed set of worker threads running submitted jobs in FIFO order. */
+class ThreadPool {
+public:
+    /* 0 => one thread per CPU */
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(std::function<void()> job);
+    unsigned size() const { return static_cast<unsigned>(workers_.size()); }
+
+private:
+    void worker();
+
+    std::vector<std::thread> workers_;
+    std::deque<std::function<void()>> jobs_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    bool stop_{false};
+};
@@ -0,0 +1,20 @@
+#pragma once
+#include <cstdint>
+#include <string>
+
+/* Maps kernel timestamps (bpf_ktime_get_ns, CLOCK_MONOTONIC) to wall-clock
+ * time. The offset is sampled once; formatting is left to the outputs
+ * that actually print wall-clock times. */
+class WallClock {
+public:
+    static const WallClock& instance();
+
+    uint64_t to_realtime_ns(uint64_t mono_ns) const { return mono_ns + offset_ns_; }
+    /* local time, "YYYY-mm-dd HH:MM:SS.uuuuuu" */
+    std::string format(uint64_t mono_ns) const;
+
+private:
+    WallClock();
+
+    uint64_t offset_ns_{0};
+};
@@ -1,18 +1,95 @@
 #pragma once
 #include <string>
 #include <cstdint>
+#include <cstddef>
+#include <vector>
 
+enum class EventKind : uint8_t {
+    Unknown = 0,
+    ExecveEntry,
+    ExecveExit,
+    Fork,           // fork children
+    Exit,
+    ExitGroup,
+    Run,            // switch-in
+    Desched,        // switch-out
+    Slice,          // completed on-CPU slice, [start, timestamp]
+    Clone,          // clone/clone3 returned in the parent; the child's Fork comes separately
+};
+
+enum class SwitchReason : uint8_t {
+    None = 0,
+    Sleep,
+    Preempt,
+    EndOfTrace,
+};
+
+inline const char* event_kind_name(EventKind k) {
+    switch (k) {
+        case EventKind::ExecveEntry: return "execve-entry";
+        case EventKind::ExecveExit:  return "execve-exit";
+        case EventKind::Fork:        return "fork";
+        case EventKind::Exit:        return "exit";
+        case EventKind::ExitGroup:   return "exit_group";
+        case EventKind::Run:         return "run";
+        case EventKind::Desched:     return "desched";
+        case EventKind::Slice:       return "slice";
+        case EventKind::Clone:       return "clone";
+        default:                     return "unknown";
+    }
+}
+
+inline const char* switch_reason_name(SwitchReason r) {
+    switch (r) {
+        case SwitchReason::Sleep:      return "sleep";
+        case SwitchReason::Preempt:    return "preempt";
+        case SwitchReason::EndOfTrace: return "end_of_trace";
+        default:                       return "";
+    }
+}
+
+/* Fixed-size event record; comm is an id into CommTable,
+ * names are only looked up when an output needs them. */
 struct Event {
-    std::string event;           
+    EventKind kind{EventKind::Unknown};
+    SwitchReason reason{SwitchReason::None};
+    uint32_t cpu{0};
     uint32_t parent_pid{0};
     uint32_t pid{0};
     uint32_t child_pid{0};
-    uint32_t pgid{0};
     uint32_t tid{0};
     uint32_t tgid{0};
-    uint32_t cpu{0};          
-    std::string command;
+    uint32_t comm{0};
     uint64_t timestamp{0};
-    std::string timestamp_human;
-    std::string reason;
+    uint64_t start{0};          // Slice only: switch-in time
+};
+
+/* Read-only view over the logger's event buffer; the buffer must outlive it. */
+class EventSpan {
+public:
+    EventSpan() = default;
+    EventSpan(const Event* data, size_t n) : data_(data), size_(n) {}
+    EventSpan(const std::vector<Event>& v) : data_(v.data()), size_(v.size()) {}
+
+    const Event* begin() const { return data_; }
+    const Event* end() const { return data_ + size_; }
+    const Event& operator[](size_t i) const { return data_[i]; }
+    const Event& front() const { return data_[0]; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+private:
+    const Event* data_{nullptr};
+    size_t size_{0};
+};
+
+/* Per-(tid,cpu) on-CPU totals aggregated in the kernel (--summary). */
+struct RuntimeStat {
+    uint32_t tid{0};
+    uint32_t cpu{0};
+    uint32_t comm{0};
+    uint64_t oncpu_ns{0};
+    uint64_t switches{0};
+    uint64_t voluntary{0};
+    uint64_t involuntary{0};
 };
@@ -3,45 +3,70 @@
 #include <atomic>
 #include <vector>
 #include <string>
-#include <thread>
-#include <mutex>
 #include "common.hpp"
+#include "EventSink.hpp"
+#include "EventChunks.hpp"
+#include "tmt_events.h"
 
 class BaseHandler {
 public:
-    explicit BaseHandler(std::string name, int poll_timeout_ms = 100)
-      : name_(std::move(name)), timeout_ms_(poll_timeout_ms) {}
-    virtual ~BaseHandler() { stop(); }
+    BaseHandler(std::string name, std::vector<uint16_t> kinds)
+      : name_(std::move(name)), kinds_(std::move(kinds)) {}
+    virtual ~BaseHandler() { detach(); }
 
-    virtual bool install() = 0;
-    virtual void detach() {}
-    virtual void freeze_producer() {}
-    virtual uint64_t snapshot_total() { return read_events_.load(); }
+    /* attach this handler's programs of the shared BPF object */
+    virtual bool install(struct bpf_object* obj) = 0;
+    virtual void detach();
 
-    void start();
-    void stop();
-    void drain_until(uint64_t total_expected);
-    std::vector<Event> collect();
+    /* decode one record of one of kinds() */
+    virtual int on_sample(void *data, size_t len) = 0;
 
-    const std::string& name() const { return name_; }
+    uint64_t read_total() const { return read_events_.load(); }
+    /* --capture: record stored undecoded, counted for the drain only */
+    void count_raw() { read_events_.fetch_add(1, std::memory_order_relaxed); }
+    /* --capture: the replay decodes, and counts, every record again */
+    void reset_read_total() { read_events_.store(0, std::memory_order_relaxed); }
 
-    static std::string human_ts(uint64_t ts_ns);
+    /* consumer side: count the poll rounds that delivered to this handler */
+    void note_round(uint64_t round) {
+        if (last_round_.load(std::memory_order_relaxed) == round) return;
+        if (last_round_.exchange(round, std::memory_order_relaxed) == round) return;
+        wakeups_.fetch_add(1, std::memory_order_relaxed);
+    }
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+    void print_wakeup_stats() const;
+    /* decoded events are also forwarded here, on the consumer thread */
+    void set_sink(EventSink* sink) { sink_ = sink; }
+    /* keep decoded events for take_events(); off when a sink consumes them */
+    void set_keep_events(bool keep) { keep_ = keep; }
+    /* number of consumer threads calling on_sample, each storing into its
+     * own slot so that none of them locks; set before the first sample */
+    void set_producers(unsigned n) { stored_.resize(n ? n : 1); }
+    /* slot of the calling consumer thread, see set_producers */
+    static void set_producer(unsigned slot) { t_slot_ = slot; }
+
+    /* hand over the decoded events, leaving the handler empty; only once
+     * the consumers are stopped */
+    std::vector<Event> take_events();
+
+    const std::string& name() const { return name_; }
+    const std::vector<uint16_t>& kinds() const { return kinds_; }
 
 protected:
-    virtual int on_sample(void *data, size_t len) = 0;
+    bool attach_tracepoint(struct bpf_object* obj, const char* prog_name,
+                           const char* category, const char* tp_name);
+    int on_task_sample(EventKind kind, void *data, size_t len);
+    void store(const Event& e);
 
-    void set_ring_buffers(struct ring_buffer* rb1, struct ring_buffer* rb2);
-    int set_cfg_enabled_map(int fd);
-    int freeze_cfg_enabled_map(int fd);
-    uint64_t snapshot_evcount_percpu(int fd);
     std::string name_;
-    int timeout_ms_;
-    std::atomic<bool> running_{false};
+    std::vector<uint16_t> kinds_;
+    std::vector<struct bpf_link*> links_;
     std::atomic<uint64_t> read_events_{0};
-    struct ring_buffer* rb1_{nullptr};
-    struct ring_buffer* rb2_{nullptr};
-    std::thread poll_thread_;
-    std::mutex mtx_;
-    std::vector<Event> events_;
-    
+    std::atomic<uint64_t> wakeups_{0};
+    std::atomic<uint64_t> last_round_{0};
+    std::vector<EventChunkList> stored_ = std::vector<EventChunkList>(1);
+    EventSink* sink_{nullptr};
+    bool keep_{true};
+
+    static thread_local unsigned t_slot_;
 };
@@ -1,32 +1,34 @@
 #pragma once
 #include "BaseHandler.hpp"
-#include <string>
+#include <shared_mutex>
+#include <vector>
+#include <unordered_map>
 
 class SwitchHandler : public BaseHandler {
 public:
-    explicit SwitchHandler(int poll_timeout_ms = 100);
-    ~SwitchHandler();
-
-    bool install() override;
-    void detach() override;
-    void freeze_producer() override;
-    uint64_t snapshot_total() override;
+    SwitchHandler();
 
+    bool install(struct bpf_object* obj) override;
     int on_sample(void *data, size_t len) override;
 
-    void set_root_pids(uint32_t shell_pid, uint32_t cmd_pid);
+    /* enum tmt_switch_mode: run/desched pairs, in-kernel summary or slices */
+    void set_mode(uint32_t mode) { mode_ = mode; }
+    uint32_t mode() const { return mode_; }
+    /* read rt_stats once producers are off; tasks still on a CPU are
+     * accounted up to now */
+    std::vector<RuntimeStat> read_summary() const;
+    /* slices mode: Run events for tasks still on a CPU, closed as end_of_trace */
+    std::vector<Event> pending_runs() const;
 
 private:
-    bpf_object* obj_{nullptr};
-    bpf_link* link_{nullptr};
-    bpf_link* link_fork_{nullptr};
-
-    int map_cfg_{-1};
-    int map_ev_{-1};
-    int map_rb_{-1};
-
-    uint32_t shell_pid_hint_ = 0;
-    uint32_t cmd_pid_hint_   = 0;
-
-    std::string resolve_bpf_obj_path() const;
+    int on_slice(void *data, size_t len);
+    int on_comm(void *data, size_t len);
+    uint32_t comm_of(uint32_t tid) const;
+
+    uint32_t mode_ = TMT_SWITCH_EVENTS;
+    // tid -> CommTable id, fed by comm records; shared by the consumer lanes
+    std::unordered_map<uint32_t, uint32_t> comm_cache_;
+    mutable std::shared_mutex comm_mtx_;
+    int map_rt_   = -1;
+    int map_run_  = -1;
 };
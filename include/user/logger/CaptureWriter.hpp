@@ -0,0 +1,65 @@
+#pragma once
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/* --capture: raw ring buffer records appended to a file, undecoded.
+ *
+ * File layout: a 16-byte header ("TMTCAP", wire version), then per record
+ * a u32 length followed by the record bytes, padded to 8 bytes so every
+ * record can be read in place. The consumer copies records into large
+ * pooled buffers; full buffers are written with writev() by a dedicated
+ * thread. When all buffers are in flight the consumer waits. */
+class CaptureWriter {
+public:
+    explicit CaptureWriter(size_t buf_size = 4 << 20, size_t nbufs = 8);
+    ~CaptureWriter();
+
+    CaptureWriter(const CaptureWriter&) = delete;
+    CaptureWriter& operator=(const CaptureWriter&) = delete;
+
+    bool open(const std::string& path);
+    /* consumer thread only */
+    void append(const void* data, uint32_t len);
+    /* write what is buffered and stop the writer thread; false on I/O error */
+    bool close();
+
+    uint64_t records() const { return records_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    struct Buffer {
+        std::unique_ptr<char[]> data;
+        size_t used{0};
+    };
+
+    void writer_loop();
+    void submit(Buffer* b);
+    Buffer* take_free();
+
+    int fd_{-1};
+    size_t buf_size_;
+    std::vector<Buffer> bufs_;
+    Buffer* cur_{nullptr};
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Buffer*> full_;
+    std::deque<Buffer*> free_;
+    bool closing_{false};
+    bool failed_{false};
+    std::thread thread_;
+
+    uint64_t records_{0};
+    uint64_t bytes_{0};
+};
+
+/* Feed every record of a capture file to cb, in capture order. */
+bool replay_capture(const std::string& path,
+                    int (*cb)(void* ctx, void* data, size_t len), void* ctx);
@@ -0,0 +1,10 @@
+#pragma once
+#include <vector>
+#include "common.hpp"
+
+/* Merge the per-handler buffers into one stream ordered by timestamp.
+ * Each buffer is split into per-CPU runs (as index lists), every run is
+ * repaired with an insertion sort, which is linear on the nearly sorted
+ * ring buffer order, and the runs are combined with a k-way heap merge.
+ * The input buffers are released. */
+std::vector<Event> merge_events(std::vector<std::vector<Event>>& parts);
@@ -0,0 +1,31 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+#include "EventChunks.hpp"
+
+/* Fixed budget of event chunks. Chunks are allocated on first use, up
+ * to the budget, and recycled afterwards; nothing is freed before the
+ * pool goes away, so the footprint stops growing once the budget is
+ * reached. */
+class EventPool {
+public:
+    /* at least min_chunks, even if max_bytes is smaller */
+    EventPool(size_t max_bytes, size_t min_chunks = 1);
+
+    /* nullptr when the whole budget is in use */
+    EventChunk* get();
+    void put(EventChunk* c);
+
+    size_t capacity() const { return capacity_; }
+    size_t in_use() const { return in_use_; }
+    size_t peak() const { return peak_; }
+    size_t bytes() const { return all_.size() * sizeof(EventChunk); }
+
+private:
+    size_t capacity_;
+    size_t in_use_{0};
+    size_t peak_{0};
+    std::vector<std::unique_ptr<EventChunk>> all_;
+    std::vector<EventChunk*> free_;
+};
@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <deque>
+#include <vector>
+#include "EventSink.hpp"
+#include "EventPool.hpp"
+
+/* Online reordering of the consumer's events. Events wait in per-CPU
+ * queues and are released to the downstream sink in timestamp order once
+ * they are below the watermark: the oldest last-seen timestamp over all
+ * CPUs or, if later, the start of the last drain round, minus a grace
+ * period. After a drain nothing older can arrive except records whose
+ * probe was preempted between reading the clock and submitting.
+ *
+ * The queues live in chunks of a fixed EventPool of max_bytes; when it
+ * is used up the oldest events are released early instead of growing. */
+class ReorderBuffer : public EventSink {
+public:
+    ReorderBuffer(EventSink& out, unsigned ncpu,
+                  uint64_t grace_ns = 10 * 1000 * 1000,
+                  size_t max_bytes = 64 << 20);
+
+    void on_event(const Event& e) override;
+
+    /* the ring buffer was drained by a round started at round_start_ns
+     * (CLOCK_MONOTONIC, like bpf_ktime_get_ns) */
+    void advance(uint64_t round_start_ns);
+    /* release everything, end of the stream */
+    void flush();
+
+    uint64_t late() const { return late_; }
+    /* events that found the pool full, so that the oldest went out early */
+    uint64_t forced() const { return forced_; }
+    size_t pending() const { return pending_; }
+    const EventPool& pool() const { return pool_; }
+
+private:
+    /* sorted by timestamp, in pool chunks */
+    struct CpuQueue {
+        std::deque<EventChunk*> chunks;
+        size_t head{0};             // first event in chunks.front()
+        size_t size{0};
+        uint64_t last_seen{0};
+
+        Event& at(size_t i) {
+            size_t p = head + i;
+            return chunks[p / EventChunk::CAP]->ev[p % EventChunk::CAP];
+        }
+        Event& front() { return chunks.front()->ev[head]; }
+    };
+
+    bool push(CpuQueue& c, const Event& e);
+    void pop_front(CpuQueue& c);
+    void release(uint64_t watermark);
+
+    EventSink& out_;
+    EventPool pool_;
+    std::vector<CpuQueue> cpus_;
+    uint64_t grace_ns_;
+    size_t pending_{0};
+    uint64_t released_ts_{0};
+    uint64_t late_{0};
+    uint64_t forced_{0};
+};
@@ -0,0 +1,61 @@
+#pragma once
+#include <bpf/libbpf.h>
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <thread>
+
+/* One libbpf ring_buffer (one epoll set) for a set of ring buffer maps,
+ * drained by a single consumer thread. Each map keeps its own sample
+ * callback/context, so dispatch to the handler is done by libbpf.
+ * The thread waits on the ring_buffer's epoll fd next to an eventfd,
+ * so stop() does not have to sit out the poll timeout. */
+class RingBufferPoller {
+public:
+    explicit RingBufferPoller(int timeout_ms = 100);
+    ~RingBufferPoller();
+
+    RingBufferPoller(const RingBufferPoller&) = delete;
+    RingBufferPoller& operator=(const RingBufferPoller&) = delete;
+
+    bool add(int map_fd, ring_buffer_sample_fn cb, void *ctx);
+    bool empty() const { return rb_ == nullptr; }
+
+    /* run on the consumer thread after each poll round, with the
+     * CLOCK_MONOTONIC time the round started; set before start() */
+    void set_round_hook(std::function<void(uint64_t)> fn) { round_hook_ = std::move(fn); }
+
+    void start();
+    /* wake the consumer thread and join it */
+    void stop();
+
+    /* non-blocking drain on the calling thread, only while stopped */
+    int consume();
+    /* consume until a pass finds nothing; total records read */
+    uint64_t drain();
+
+    uint64_t samples() const { return samples_.load(std::memory_order_relaxed); }
+    uint64_t wakeups() const { return wakeups_.load(std::memory_order_relaxed); }
+    uint64_t timer_flushes() const { return timer_flushes_.load(std::memory_order_relaxed); }
+    /* bumped before every poll/consume, lets callbacks tell batches apart */
+    uint64_t round() const { return round_.load(std::memory_order_relaxed); }
+    void print_stats(const char* tag = "consumer") const;
+
+private:
+    void close_fds();
+
+    int timeout_ms_;
+    struct ring_buffer* rb_{nullptr};
+    int epfd_{-1};
+    int wake_fd_{-1};
+    std::thread thread_;
+    std::function<void(uint64_t)> round_hook_;
+    std::atomic<bool> running_{false};
+    std::atomic<uint64_t> samples_{0};
+    std::atomic<uint64_t> wakeups_{0};
+    std::atomic<uint64_t> timer_flushes_{0};
+    std::atomic<uint64_t> round_{0};
+    uint64_t started_ns_{0};
+    uint64_t stopped_ns_{0};
+};
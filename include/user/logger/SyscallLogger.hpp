@@ -1,6 +1,10 @@
 #pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <vector>
 #include <memory>
+#include <mutex>
 #include <string>
 #include "common.hpp"
 #include "BaseHandler.hpp"
@@ -11,22 +15,129 @@
 #include "Clone3Handler.hpp"
 #include "ExitGroupHandler.hpp"
 #include "SwitchHandler.hpp"
+#include "RingBufferPoller.hpp"
+#include "ReorderBuffer.hpp"
+#include "CaptureWriter.hpp"
+
+struct tmt_bpf;
+class LiveFanout;
+class ConsumerLane;
 
 class SyscallLogger {
 public:
     explicit SyscallLogger(int timeout_ms = 100);
+    ~SyscallLogger();
 
     bool install_all();
     void coordinated_stop();
 
     void run_command(const std::string& cmd, bool print_raw = false);
 
+    void set_verbose(bool v) { verbose_ = v; }
+    /* enum tmt_switch_mode, see SwitchHandler::set_mode */
+    void set_switch_mode(uint32_t mode) { switch_mode_ = mode; }
+    /* wake the consumer only once this many bytes are unread, 0 => per record */
+    void set_wakeup_bytes(uint32_t bytes) { wakeup_bytes_ = bytes; }
+    /* n ring buffers, CPU c writing to ring c % n; 0 => the shared one */
+    void set_rings(uint32_t n) { rings_ = n; }
+    /* consumer threads, each draining every n-th ring (needs set_rings) */
+    void set_consumers(uint32_t n) { consumers_ = n ? n : 1; }
+    /* --summary: threads the in-kernel runtime table holds, 0 => default */
+    void set_summary_size(uint32_t n) { summary_size_ = n; }
+    /* capacity of the traced-tid filter, 0 => the BPF object's default */
+    void set_filter_size(uint32_t n) { filter_size_ = n; }
+    /* --print-raw shows wall-clock times instead of ns since the first event */
+    void set_wall_clock(bool on) { wall_clock_ = on; }
+    /* store raw records in this file during the run, decode them after the stop */
+    void set_capture(const std::string& path) { capture_path_ = path; }
+    /* analysis consumer, fed in timestamp order while the command runs;
+     * gets on_begin(root pid) first and on_end() once the drain is done */
+    void add_sink(EventSink* sink);
+    /* sinks write as they go: t=0 is the start of tracing, not the first event */
+    void set_streaming(bool on) { streaming_ = on; }
+    /* memory for events waiting to be reordered, see ReorderBuffer */
+    void set_reorder_bytes(size_t bytes) { reorder_bytes_ = bytes; }
+    /* reference point for the startup-latency report (normally main entry) */
+    void set_start_time(std::chrono::steady_clock::time_point t) { t_start_ = t; }
+
+    /* merged events, raw kernel timestamps; only kept when no sink is added */
     const std::vector<Event>& events() const { return events_; }
     uint32_t root_pid() const { return root_pid_; }
+    /* records lost in the kernel or never read; non-zero => output is incomplete */
+    uint64_t lost_events() const { return lost_events_; }
+    /* t=0 of the outputs: kernel time of the first event (or slice start),
+     * or of the start of tracing when streaming */
+    uint64_t origin_ns() const { return origin_ns_; }
+    const std::vector<RuntimeStat>& runtime_summary() const { return summary_stats_; }
 
 private:
+    bool load_bpf();
+    bool create_rings();
+    bool insert_rings();
+    bool install_filter();
+    void report_filter();
+    void make_lanes();
+    void flush_lane(ConsumerLane& lane, uint64_t round_start);
+    void set_producers_enabled(bool on);
+    void set_wakeup_threshold();
+    std::vector<std::vector<uint64_t>> read_kind_counts(int map_fd) const;
+    std::vector<uint64_t> snapshot_ev_counts() const;
+    std::vector<uint64_t> freeze_counts() const;
+    void track_seq(uint16_t cpu, uint32_t seq);
+    void report_losses(const std::vector<uint64_t>& totals);
+    uint64_t drain_until(const std::vector<uint64_t>& totals);
+    static int dispatch_cb(void *ctx, void *data, size_t len);
+    static int replay_cb(void *ctx, void *data, size_t len);
+    void replay_capture_file();
+
+    void start_live_output(bool print_raw);
+
     std::vector<std::unique_ptr<BaseHandler>> handlers_;
+    // live: handlers -> reorder_ -> fanout_ -> sinks (and --print-raw);
+    // with several lanes the handlers feed lane_router_ and each lane
+    // hands its batch to reorder_ under reorder_mtx_ once per poll round
+    std::unique_ptr<LiveFanout> fanout_;
+    std::unique_ptr<EventSink> raw_printer_;
+    std::unique_ptr<ReorderBuffer> reorder_;
+    std::unique_ptr<EventSink> lane_router_;
+    std::mutex reorder_mtx_;
+    bool live_{false};
+    bool has_sinks_{false};
+    bool streaming_{false};
+    size_t reorder_bytes_{64 << 20};
+    std::string capture_path_;
+    std::unique_ptr<CaptureWriter> capture_;
+    std::mutex capture_mtx_;
+    std::array<BaseHandler*, TMT_EV_MAX> by_kind_{};
     std::vector<Event> events_;
+    std::vector<RuntimeStat> summary_stats_;
     int timeout_ms_{100};
+    std::vector<std::unique_ptr<ConsumerLane>> lanes_;
+    uint32_t rings_{0};
+    uint32_t consumers_{1};
+    std::vector<int> ring_fds_;
+    uint32_t filter_size_{0};
+    uint32_t summary_size_{0};
+    struct bpf_link* exit_link_{nullptr};
+    struct tmt_bpf* skel_{nullptr};
+    int map_cfg_{-1};
+    int map_ev_{-1};
+    int map_events_{-1};
+    int map_drops_{-1};
+    // per-CPU last record sequence number and the gaps found in it;
+    // a CPU's records all come through the same lane
+    std::vector<uint32_t> last_seq_;
+    std::vector<uint64_t> seq_gaps_;
+    uint64_t lost_events_{0};
+    uint64_t origin_ns_{0};
+    std::atomic<uint64_t> bad_version_{0};
     uint32_t root_pid_ = 0;
+
+    bool verbose_{false};
+    bool wall_clock_{false};
+    uint32_t switch_mode_{TMT_SWITCH_EVENTS};
+    uint32_t wakeup_bytes_{64 * 1024};
+    std::chrono::steady_clock::time_point t_start_{std::chrono::steady_clock::now()};
+    double load_ms_{0.0};
+    double attach_ms_{0.0};
 };
@@ -1,32 +1,55 @@
 #pragma once
 #include "common.hpp"
+#include "EventSink.hpp"
+#include "CsvWriter.hpp"
 #include <vector>
 #include <string>
 #include <memory>
 
 #define TMT_DEBUG_INTERVALS 0 
 
-struct Node;
+struct ProcTree;
 
 struct TimeInterval {
     uint64_t time;
     int alive;
 };
 
-class EventProcessor {
+/* Alive-thread series, built incrementally: every event updates the
+ * process tree and the alive count as it arrives. */
+class EventProcessor : public EventSink {
 public:
-    explicit EventProcessor(const std::vector<Event>& evs, uint32_t root_pid = 0);
+    /* root_pid 0 => on_begin() or the first event decides */
+    explicit EventProcessor(uint32_t root_pid = 0);
     ~EventProcessor();
 
-    void build_tree(bool print_tree = false);
-    void compute_intervals(bool print_intervals = false);
-    void store_to_csv(const std::string& filename = "out/alive_series.csv") const;
+    /* write each point to filename as it is produced instead of keeping
+     * the series; times are relative to on_begin()'s start_ns */
+    bool stream_to(const std::string& filename);
+
+    void on_begin(uint32_t root_pid, uint64_t start_ns) override;
+    /* events must arrive in timestamp order */
+    void on_event(const Event& e) override;
+    void on_end() override;
+
+    uint64_t event_count() const { return events_; }
+    void print_tree() const;
+    /* times are written relative to origin_ns */
+    void store_to_csv(const std::string& filename = "out/alive_series.csv",
+                      uint64_t origin_ns = 0) const;
 
 private:
-    void print_tree_rec(const Node& n, int depth) const;
+    void print_tree_rec(uint32_t idx, int depth) const;
+    void add_point(uint64_t time, int alive);
 
-    std::vector<Event> events_;
-    std::unique_ptr<Node> root_;
+    std::unique_ptr<ProcTree> tree_;
     std::vector<TimeInterval> time_intervals_;
     uint32_t root_pid_hint_ = 0;
+    bool root_comm_known_ = false;
+    uint64_t events_ = 0;
+    uint64_t max_ts_ = 0;
+    TimeInterval last_{0, -1};
+    CsvWriter stream_;
+    std::string stream_path_;
+    uint64_t stream_origin_ = 0;
 };
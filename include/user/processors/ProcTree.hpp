@@ -0,0 +1,110 @@
+#pragma once
+#include "common.hpp"
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+/* Flat process tree: nodes live in an arena and refer to each other by
+ * index, pid_index_ finds every node of a pid. A node is counted as alive
+ * when it and all its ancestors are alive ("effective"), and that count
+ * is kept up to date as nodes are born and killed. */
+struct ProcTree {
+    static constexpr uint32_t NONE = UINT32_MAX;
+
+    struct Node {
+        Node(uint32_t pid, uint32_t comm, uint32_t parent)
+        : pid(pid), comm(comm), parent(parent) {}
+
+        uint32_t pid;
+        uint32_t comm;
+        uint32_t parent;
+        bool alive{false};
+        bool effective{false};
+        bool nested{false};     // an ancestor has the same pid
+        std::vector<uint32_t> children;
+    };
+
+    std::vector<Node> nodes;
+    std::unordered_map<uint32_t, std::vector<uint32_t>> pid_index;
+    int alive_count{0};
+
+    uint32_t add(uint32_t pid, uint32_t comm, uint32_t parent) {
+        uint32_t idx = static_cast<uint32_t>(nodes.size());
+        nodes.emplace_back(pid, comm, parent);
+        for (uint32_t a = parent; a != NONE; a = nodes[a].parent) {
+            if (nodes[a].pid == pid) { nodes[idx].nested = true; break; }
+        }
+        if (parent != NONE) nodes[parent].children.push_back(idx);
+        pid_index[pid].push_back(idx);
+        return idx;
+    }
+
+    /* a fork hangs the child under the parent pid's node that comes first
+     * in depth-first order; a pid usually has a single node */
+    bool add_child(const Event& e) {
+        if (e.kind != EventKind::Fork) return false;
+        auto it = pid_index.find(e.pid);
+        if (it == pid_index.end()) return false;
+        uint32_t parent = it->second.front();
+        for (size_t i = 1; i < it->second.size(); ++i)
+            if (precedes(it->second[i], parent)) parent = it->second[i];
+        add(e.child_pid, e.comm, parent);
+        return true;
+    }
+
+    /* the outermost nodes of pid come alive, not ones nested below them */
+    void set_alive(uint32_t pid) {
+        auto it = pid_index.find(pid);
+        if (it == pid_index.end()) return;
+        for (uint32_t idx : it->second) {
+            Node& n = nodes[idx];
+            if (n.alive || n.nested) continue;
+            n.alive = true;
+            if (n.parent == NONE || nodes[n.parent].effective)
+                make_effective(idx);
+        }
+    }
+
+    /* kills every node of pid together with its whole subtree */
+    void set_dead(uint32_t pid) {
+        auto it = pid_index.find(pid);
+        if (it == pid_index.end()) return;
+        std::vector<uint32_t> stack;
+        for (uint32_t idx : it->second) {
+            stack.push_back(idx);
+            while (!stack.empty()) {
+                Node& n = nodes[stack.back()];
+                stack.pop_back();
+                if (n.effective) --alive_count;
+                n.alive = n.effective = false;
+                stack.insert(stack.end(), n.children.begin(), n.children.end());
+            }
+        }
+    }
+
+private:
+    /* depth-first order of a and b; siblings are ordered by index */
+    bool precedes(uint32_t a, uint32_t b) const {
+        std::vector<uint32_t> pa, pb;
+        for (uint32_t x = a; x != NONE; x = nodes[x].parent) pa.push_back(x);
+        for (uint32_t x = b; x != NONE; x = nodes[x].parent) pb.push_back(x);
+        auto ia = pa.rbegin(), ib = pb.rbegin();
+        while (ia != pa.rend() && ib != pb.rend() && *ia == *ib) { ++ia; ++ib; }
+        if (ia == pa.rend()) return true;     // a is an ancestor of b
+        if (ib == pb.rend()) return false;
+        return *ia < *ib;
+    }
+
+    /* idx just got an effective parent: it and its alive descendants count */
+    void make_effective(uint32_t idx) {
+        std::vector<uint32_t> stack{idx};
+        while (!stack.empty()) {
+            Node& n = nodes[stack.back()];
+            stack.pop_back();
+            n.effective = true;
+            ++alive_count;
+            for (uint32_t c : n.children)
+                if (nodes[c].alive && !nodes[c].effective) stack.push_back(c);
+        }
+    }
+};
@@ -1,29 +1,65 @@
 #pragma once
 #include "common.hpp"
+#include "EventSink.hpp"
+#include "CsvWriter.hpp"
+#include <map>
+#include <tuple>
 #include <vector>
 #include <string>
 
 struct Slice {
     uint32_t pid;
     uint32_t cpu;
-    std::string command;
+    uint32_t comm;              // CommTable id
     uint64_t start_ns;
     uint64_t end_ns;
     uint64_t delta_ns;
-    std::string reason;
+    SwitchReason reason;
 };
 
-class SwitchProcessor {
+/* On-CPU slices, built incrementally from the switch events (run,
+ * desched, slice); other events are ignored. */
+class SwitchProcessor : public EventSink {
 public:
-    explicit SwitchProcessor(const std::vector<Event>& events);
+    explicit SwitchProcessor(bool debug = false);
 
-    void build_slices(bool debug = false);
-    void store_csv(const std::string& filename = "out/oncpu_slices.csv") const;
+    /* write each slice to filename once it is complete instead of keeping
+     * it; times are relative to on_begin()'s start_ns */
+    bool stream_to(const std::string& filename);
+
+    void on_begin(uint32_t root_pid, uint64_t start_ns) override;
+    void on_event(const Event& e) override;
+    /* closes the slices still open at the last switch event */
+    void on_end() override;
+
+    /* use kernel-aggregated runtimes (--summary) instead of slices */
+    void load_summary(const std::vector<RuntimeStat>& stats);
+    /* times are written relative to origin_ns */
+    void store_csv(const std::string& filename = "out/oncpu_slices.csv",
+                   uint64_t origin_ns = 0) const;
     void plot_top_runtime_per_cpu(int top_n = 10,
                                   const std::string& time_unit = "ms",
                                   const std::string& outfile_prefix = "out/top_runtime_cpu_") const;
 
 private:
-    std::vector<Event> events_;
+    struct OpenRun {
+        uint64_t start;
+        uint32_t cpu;
+        uint32_t comm;
+    };
+
+    void add_slice(const Slice& s);
+
+    bool debug_;
+    std::map<uint32_t, OpenRun> open_;      // by pid
+    uint64_t switch_events_{0};
+    uint64_t end_ts_{0};
+    uint64_t slice_count_{0};
     std::vector<Slice> slices_;
+    // total runtime per (cpu, pid, comm), kept even when streaming
+    std::map<std::tuple<uint32_t, uint32_t, uint32_t>, uint64_t> runtime_;
+    CsvWriter stream_;
+    std::string stream_path_;
+    uint64_t stream_origin_{0};
+    std::vector<RuntimeStat> summary_;
 };
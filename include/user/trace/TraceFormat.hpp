@@ -0,0 +1,113 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/* .tmt trace file, little-endian:
+ *
+ *   TraceFileHeader
+ *   chunk 0 .. chunk N-1     columnar, see TraceColumn
+ *   comm dictionary          u32 count, then per name: u8 len + bytes
+ *   runtime summary          u32 count, then TraceRuntimeStat[count]
+ *   chunk index              TraceChunkInfo[N]
+ *   TraceFileTrailer         fixed size, at the very end
+ *
+ * A chunk holds up to TMT_TRACE_CHUNK_EVENTS events stored column by
+ * column: u32 byte length of every column, then the column bytes.
+ * Integer columns are LEB128 varints; pid-like columns and the timestamp
+ * are zigzag deltas against the previous event of the chunk, the slice
+ * start is stored as (timestamp - start). Comms are ids into the file's
+ * dictionary. The index lets a reader pick chunks by time or pid
+ * without touching the others. */
+
+#define TMT_TRACE_VERSION 1
+#define TMT_TRACE_CHUNK_EVENTS (64 * 1024)
+
+enum TraceFlags : uint32_t {
+    TMT_TRACE_SUMMARY = 1u << 0,    // switch data is in the runtime summary
+};
+
+enum TraceColumn {
+    TCOL_KIND = 0,      // u8
+    TCOL_REASON,        // u8
+    TCOL_CPU,
+    TCOL_PID,
+    TCOL_PARENT_PID,
+    TCOL_CHILD_PID,
+    TCOL_TID,
+    TCOL_TGID,
+    TCOL_COMM,
+    TCOL_TIMESTAMP,
+    TCOL_START,
+    TCOL_MAX,
+};
+
+struct TraceFileHeader {
+    char magic[8];              // "TMTTRACE"
+    uint32_t version;
+    uint32_t flags;             // TraceFlags
+    uint32_t root_pid;
+    uint32_t reserved;
+    uint64_t origin_ns;         // t=0 of the outputs; event times are raw kernel times
+};
+
+struct TraceChunkInfo {
+    uint64_t offset;
+    uint32_t size;
+    uint32_t count;
+    uint64_t t_min;
+    uint64_t t_max;
+    uint32_t pid_min;
+    uint32_t pid_max;
+    uint64_t pid_mask;          // bit trace_pid_bit() of every pid and tid
+};
+
+struct TraceRuntimeStat {
+    uint32_t tid;
+    uint32_t cpu;
+    uint32_t comm;              // dictionary id
+    uint32_t reserved;
+    uint64_t oncpu_ns;
+    uint64_t switches;
+    uint64_t voluntary;
+    uint64_t involuntary;
+};
+
+struct TraceFileTrailer {
+    uint64_t dict_offset;
+    uint64_t summary_offset;
+    uint64_t index_offset;
+    uint64_t events;
+    uint32_t chunks;
+    uint32_t reserved;
+    char magic[8];              // "TMTTEND\0"
+};
+
+static const char TMT_TRACE_MAGIC[8] = {'T', 'M', 'T', 'T', 'R', 'A', 'C', 'E'};
+static const char TMT_TRACE_END_MAGIC[8] = {'T', 'M', 'T', 'T', 'E', 'N', 'D', 0};
+
+inline unsigned trace_pid_bit(uint32_t pid) {
+    return (uint32_t)(pid * 0x9E3779B1u) >> 26;
+}
+
+inline void put_varint(std::vector<uint8_t>& out, uint64_t v) {
+    while (v >= 0x80) {
+        out.push_back((uint8_t)(v | 0x80));
+        v >>= 7;
+    }
+    out.push_back((uint8_t)v);
+}
+
+/* false on a truncated or over-long varint */
+inline bool get_varint(const uint8_t*& p, const uint8_t* end, uint64_t& v) {
+    v = 0;
+    for (unsigned shift = 0; shift < 64 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        v |= (uint64_t)(b & 0x7f) << shift;
+        if (!(b & 0x80)) return true;
+    }
+    return false;
+}
+
+inline uint64_t zigzag(int64_t v) { return ((uint64_t)v << 1) ^ (uint64_t)(v >> 63); }
+inline int64_t unzigzag(uint64_t v) { return (int64_t)(v >> 1) ^ -(int64_t)(v & 1); }
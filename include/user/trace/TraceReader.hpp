@@ -0,0 +1,51 @@
+#pragma once
+#include "common.hpp"
+#include "TraceFormat.hpp"
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/* mmap-based reader for .tmt traces. Chunks are decoded on demand, so
+ * callers that only need a time window or a few pids touch only the
+ * chunks the index points them to. */
+class TraceReader {
+public:
+    TraceReader() = default;
+    ~TraceReader();
+
+    TraceReader(const TraceReader&) = delete;
+    TraceReader& operator=(const TraceReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+
+    uint32_t root_pid() const { return header_.root_pid; }
+    uint64_t origin_ns() const { return header_.origin_ns; }
+    bool has_summary() const { return header_.flags & TMT_TRACE_SUMMARY; }
+    uint64_t event_count() const { return events_; }
+
+    size_t chunk_count() const { return index_.size(); }
+    const TraceChunkInfo& chunk(size_t i) const { return index_[i]; }
+    /* chunks overlapping [from, to], in file order */
+    std::vector<size_t> chunks_in(uint64_t from, uint64_t to) const;
+    /* false => the chunk has no event of pid (as pid or tid) */
+    bool chunk_may_contain(size_t i, uint32_t pid) const;
+
+    /* decode chunk i and append its events to out */
+    bool read_chunk(size_t i, std::vector<Event>& out) const;
+    std::vector<Event> read_all() const;
+    /* runtime summary of a --summary trace, comms mapped to CommTable */
+    const std::vector<RuntimeStat>& summary() const { return summary_; }
+
+private:
+    bool fail(const char* what);
+
+    std::string path_;
+    const uint8_t* base_{nullptr};
+    size_t size_{0};
+    TraceFileHeader header_{};
+    uint64_t events_{0};
+    std::vector<TraceChunkInfo> index_;
+    std::vector<uint32_t> comm_ids_;    // dictionary id -> CommTable id
+    std::vector<RuntimeStat> summary_;
+};
@@ -0,0 +1,56 @@
+#pragma once
+#include "common.hpp"
+#include "EventSink.hpp"
+#include "TraceFormat.hpp"
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/* Writes a .tmt trace (see TraceFormat.hpp). Events must be appended
+ * in timestamp order for the chunk index to be useful. As a sink it
+ * takes root pid and origin from on_begin(); the header is rewritten on
+ * close(), so both can still be changed until then. */
+class TraceWriter : public EventSink {
+public:
+    TraceWriter() = default;
+    ~TraceWriter();
+
+    TraceWriter(const TraceWriter&) = delete;
+    TraceWriter& operator=(const TraceWriter&) = delete;
+
+    bool open(const std::string& path, uint32_t root_pid = 0, uint64_t origin_ns = 0);
+    void set_origin(uint64_t origin_ns) { header_.origin_ns = origin_ns; }
+    void append(const Event& e);
+
+    void on_begin(uint32_t root_pid, uint64_t start_ns) override;
+    void on_event(const Event& e) override { append(e); }
+
+    void append(EventSpan events);
+    /* --summary runs: the kernel-aggregated runtimes */
+    void set_summary(const std::vector<RuntimeStat>& stats);
+    bool close();
+
+    uint64_t events() const { return events_; }
+
+private:
+    void flush_chunk();
+    uint32_t dict_id(uint32_t comm);
+    bool write(const void* data, size_t len);
+
+    FILE* fp_{nullptr};
+    std::string path_;
+    uint64_t offset_{0};
+    uint64_t events_{0};
+    bool failed_{false};
+    TraceFileHeader header_{};
+
+    std::vector<Event> pending_;
+    std::vector<uint8_t> cols_[TCOL_MAX];
+    std::vector<TraceChunkInfo> index_;
+    std::vector<RuntimeStat> summary_;
+
+    // CommTable id -> dictionary id, and the dictionary itself
+    std::unordered_map<uint32_t, uint32_t> dict_ids_;
+    std::vector<uint32_t> dict_;
+};
@@ -1,12 +1,17 @@
 #include "SyscallLogger.hpp"
 #include "EventProcessor.hpp"
 #include "SwitchProcessor.hpp"
+#include "TraceReader.hpp"
+#include "TraceWriter.hpp"
+#include "TaskGraph.hpp"
 
 #include <iostream>
 #include <sstream>
 #include <string>
 #include <vector>
 #include <cstring>
+#include <chrono>
+#include <atomic>
 
 #include <args.hxx>
 
@@ -25,13 +30,59 @@ static void print_banner() {
 static void usage(const char* prog) {
     std::cerr
         << "Usage:\n"
-        << "  sudo " << prog << " --cmd \"<command to trace>\" [--print-raw]\n\n"
+        << "  sudo " << prog << " --cmd \"<command to trace>\" [--print-raw [--wall-clock]] [--verbose] [--summary [--summary-size N] | --kernel-slices] [--wakeup-bytes N] [--rings N [--consumers M]] [--filter-size N] [--capture FILE] [--save-trace FILE.tmt] [--stream] [--max-mem MiB]\n"
+        << "  " << prog << " --replay FILE.tmt\n\n"
         << "Examples:\n"
         << "  sudo " << prog << " --cmd \"sleep 1\"\n"
         << "  sudo " << prog << " --cmd \"python3 thread_test.py\" --print-raw\n";
 }
 
+/* Replays a trace into both processors. Chunks are decoded in parallel
+ * into a window of slots; each processor takes them in order on its own
+ * task, and a slot is reused once both are done with it. */
+static void replay_chunks(const TraceReader& reader, EventProcessor& ep,
+                          SwitchProcessor& sp, ThreadPool& pool) {
+    const size_t n = reader.chunk_count();
+    const size_t window = 2 * pool.size();
+    std::vector<std::vector<Event>> slots(window);
+    std::atomic<size_t> corrupt{n};
+
+    TaskGraph g;
+    std::vector<TaskGraph::Id> feed_ep(n), feed_sp(n);
+    for (size_t i = 0; i < n; ++i) {
+        std::vector<TaskGraph::Id> deps;
+        if (i >= window) deps = {feed_ep[i - window], feed_sp[i - window]};
+        auto decode = g.add("decode", [&, i]() {
+            auto& slot = slots[i % window];
+            slot.clear();
+            if (!reader.read_chunk(i, slot)) {
+                size_t cur = corrupt.load();
+                while (i < cur && !corrupt.compare_exchange_weak(cur, i)) {}
+            }
+        }, deps);
+
+        // events past a corrupt chunk are dropped, as a sequential read would
+        auto feed = [&, i](EventSink& s) {
+            if (i >= corrupt.load()) return;
+            for (const auto& e : slots[i % window]) s.on_event(e);
+        };
+        deps = {decode};
+        if (i) deps.push_back(feed_ep[i - 1]);
+        feed_ep[i] = g.add("alive series", [feed, &ep]() { feed(ep); }, deps);
+        deps = {decode};
+        if (i) deps.push_back(feed_sp[i - 1]);
+        feed_sp[i] = g.add("slices", [feed, &sp]() { feed(sp); }, deps);
+    }
+    g.run(pool);
+
+    if (corrupt.load() < n)
+        std::cerr << "[WARN] chunk " << corrupt.load() << " is corrupt, stopping there\n";
+    ep.on_end();
+    sp.on_end();
+}
+
 int main(int argc, char** argv) {
+    auto t_main = std::chrono::steady_clock::now();
     print_banner();
 
     std::string cmd;
@@ -52,7 +103,7 @@ int main(int argc, char** argv) {
     args::ValueFlag<std::string> cmd_flag(
         parser,
         "command",
-        "Command to execute and trace (required)",
+        "Command to execute and trace (required unless --replay)",
         {"cmd"}
     );
 
@@ -63,6 +114,104 @@ int main(int argc, char** argv) {
         {"print-raw"}
     );
 
+    args::Flag wall_clock_flag(
+        parser,
+        "wall-clock",
+        "With --print-raw, print wall-clock times instead of ns since the first event",
+        {"wall-clock"}
+    );
+
+    args::Flag verbose_flag(
+        parser,
+        "verbose",
+        "Print startup latency and consumer statistics",
+        {'v', "verbose"}
+    );
+
+    args::Flag summary_flag(
+        parser,
+        "summary",
+        "Aggregate per-thread runtime in the kernel instead of recording every context switch",
+        {"summary"}
+    );
+
+    args::ValueFlag<uint32_t> summary_size_flag(
+        parser,
+        "N",
+        "With --summary, threads the in-kernel runtime table can hold (default 16384)",
+        {"summary-size"}
+    );
+
+    args::Flag kslices_flag(
+        parser,
+        "kernel-slices",
+        "Let the kernel pair switch-in/out and emit one record per on-CPU slice",
+        {"kernel-slices"}
+    );
+
+    args::ValueFlag<uint32_t> wakeup_flag(
+        parser,
+        "bytes",
+        "Wake the consumer once this many bytes are buffered (0 = every event, default 65536)",
+        {"wakeup-bytes"}
+    );
+
+    args::ValueFlag<uint32_t> rings_flag(
+        parser,
+        "N",
+        "Use N ring buffers, CPU c writing to ring c % N (0 = one shared ring, default)",
+        {"rings"}
+    );
+
+    args::ValueFlag<uint32_t> consumers_flag(
+        parser,
+        "M",
+        "Drain the --rings ring buffers with M consumer threads (default 1)",
+        {"consumers"}
+    );
+
+    args::ValueFlag<uint32_t> filter_size_flag(
+        parser,
+        "N",
+        "Room for N live tasks of the traced command in the kernel filter (default 65536)",
+        {"filter-size"}
+    );
+
+    args::ValueFlag<std::string> capture_flag(
+        parser,
+        "file",
+        "Store raw kernel records in FILE during the run and decode them after it",
+        {"capture"}
+    );
+
+    args::ValueFlag<std::string> save_trace_flag(
+        parser,
+        "file",
+        "Also write the collected events to a .tmt trace file",
+        {"save-trace"}
+    );
+
+    args::ValueFlag<std::string> replay_flag(
+        parser,
+        "file",
+        "Analyse a .tmt trace instead of running a command",
+        {"replay"}
+    );
+
+    args::Flag stream_flag(
+        parser,
+        "stream",
+        "Write slices and alive points to the CSVs as they are produced (bounded memory)",
+        {"stream"}
+    );
+
+    args::ValueFlag<size_t> max_mem_flag(
+        parser,
+        "MiB",
+        "Memory for events waiting to be put in time order (default 64)",
+        {"max-mem"}
+    );
+
     try {
         parser.ParseCLI(argc, argv);
     } catch (const args::Help&) {
@@ -74,36 +223,137 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    if (!cmd_flag) {
+    if (!cmd_flag && !replay_flag) {
         usage(argv[0]);
         std::cerr << "\nError: --cmd is required.\n";
         return 1;
     }
 
-    cmd = args::get(cmd_flag);
-    print_raw = print_raw_flag; 
+    if (cmd_flag && replay_flag) {
+        std::cerr << "Error: --cmd and --replay are mutually exclusive.\n";
+        return 1;
+    }
+
+    if (summary_flag && kslices_flag) {
+        std::cerr << "Error: --summary and --kernel-slices are mutually exclusive.\n";
+        return 1;
+    }
+
+    if (consumers_flag && args::get(consumers_flag) > 1 && !(rings_flag && args::get(rings_flag))) {
+        std::cerr << "Error: --consumers needs --rings, the shared ring has a single consumer.\n";
+        return 1;
+    }
+
+    if (capture_flag && stream_flag) {
+        std::cerr << "Error: --capture decodes after the run, it cannot be combined with --stream.\n";
+        return 1;
+    }
+
+    if (capture_flag && print_raw_flag) {
+        std::cerr << "Error: --capture does not decode during the run, drop --print-raw.\n";
+        return 1;
+    }
 
     SyscallLogger logger(100);
-    logger.run_command(cmd, print_raw);
+    ThreadPool pool;
+    EventProcessor ep;
+    SwitchProcessor sp;
+    uint64_t origin_ns = 0;
+    uint64_t lost = 0;
+    bool summary_mode = summary_flag;
+    TraceReader reader;
 
-    const auto& evs = logger.events();
-    if (evs.empty()) {
-        std::cerr << "No events collected.\n";
-        return 0;
+    if (replay_flag) {
+        if (!reader.open(args::get(replay_flag))) return 1;
+        summary_mode = reader.has_summary();
     }
 
-    EventProcessor ep(logger.events(), logger.root_pid());
-    ep.build_tree(false);
-    ep.compute_intervals(false);
+    if (stream_flag) {
+        ep.stream_to("out/alive_series.csv");
+        if (!summary_mode) sp.stream_to("out/oncpu_slices.csv");
+    }
+
+    if (replay_flag) {
+        std::cout << "Replaying " << args::get(replay_flag) << ": "
+                  << reader.event_count() << " events in "
+                  << reader.chunk_count() << " chunks\n";
+
+        ep.on_begin(reader.root_pid(), reader.origin_ns());
+        sp.on_begin(reader.root_pid(), reader.origin_ns());
+        replay_chunks(reader, ep, sp, pool);
+
+        origin_ns = reader.origin_ns();
+        if (summary_mode) sp.load_summary(reader.summary());
+    } else {
+        cmd = args::get(cmd_flag);
+        print_raw = print_raw_flag;
+
+        logger.set_verbose(verbose_flag);
+        if (summary_flag)
+            logger.set_switch_mode(TMT_SWITCH_SUMMARY);
+        else if (kslices_flag)
+            logger.set_switch_mode(TMT_SWITCH_SLICES);
+        logger.set_start_time(t_main);
+        logger.set_wall_clock(wall_clock_flag);
+        if (wakeup_flag) logger.set_wakeup_bytes(args::get(wakeup_flag));
+        if (rings_flag) logger.set_rings(args::get(rings_flag));
+        if (consumers_flag) logger.set_consumers(args::get(consumers_flag));
+        if (filter_size_flag) logger.set_filter_size(args::get(filter_size_flag));
+        if (summary_size_flag) logger.set_summary_size(args::get(summary_size_flag));
+        if (capture_flag) logger.set_capture(args::get(capture_flag));
+        if (max_mem_flag) logger.set_reorder_bytes(args::get(max_mem_flag) << 20);
+        logger.set_streaming(stream_flag);
 
-    ep.store_to_csv("out/alive_series.csv");
+        // the processors (and the trace writer) run on the consumer thread
+        // while the command runs
+        logger.add_sink(&ep);
+        if (!summary_flag) logger.add_sink(&sp);
+        TraceWriter tw;
+        bool save = save_trace_flag && tw.open(args::get(save_trace_flag));
+        if (save) logger.add_sink(&tw);
 
-    SwitchProcessor sp(evs);
-    sp.build_slices(false);
-    sp.store_csv("out/oncpu_slices.csv");
-    sp.plot_top_runtime_per_cpu(10, "ms", "out/top_runtime_cpu_");
+        logger.run_command(cmd, print_raw);
+
+        origin_ns = logger.origin_ns();
+        lost = logger.lost_events();
+        if (summary_flag) sp.load_summary(logger.runtime_summary());
+
+        if (save) {
+            tw.set_origin(origin_ns);
+            if (summary_flag) tw.set_summary(logger.runtime_summary());
+            if (tw.close())
+                std::cout << "Trace written to " << args::get(save_trace_flag) << "\n";
+            else
+                std::cerr << "[WARN] could not write " << args::get(save_trace_flag) << "\n";
+        }
+    }
+
+    if (!ep.event_count()) {
+        std::cerr << "No events collected.\n";
+        return 0;
+    }
+
+    // the two CSVs are independent; the report goes last so its lines
+    // do not interleave with theirs
+    TaskGraph outputs;
+    std::vector<TaskGraph::Id> writers;
+    if (!stream_flag) {
+        writers.push_back(outputs.add("alive_series.csv", [&]() {
+            ep.store_to_csv("out/alive_series.csv", origin_ns);
+        }));
+        if (!summary_mode)
+            writers.push_back(outputs.add("oncpu_slices.csv", [&]() {
+                sp.store_csv("out/oncpu_slices.csv", origin_ns);
+            }));
+    }
+    outputs.add("top runtime", [&]() {
+        sp.plot_top_runtime_per_cpu(10, "ms", "out/top_runtime_cpu_");
+    }, writers);
+    outputs.run(pool);
 
-    std::cout << "Done. Events: " << evs.size()
-              << " | alive series written to out/alive_series.csv\n";
+    std::cout << "Done. Events: " << ep.event_count();
+    if (lost)
+        std::cout << " (INCOMPLETE: " << lost << " lost)";
+    std::cout << " | alive series written to out/alive_series.csv\n";
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,508 @@
+#include "vmlinux.h"
+#include <bpf/bpf_helpers.h>
+#include <bpf/bpf_tracing.h>
+#include <bpf/bpf_core_read.h>
+#include "common.h"
+
+char LICENSE[] SEC("license") = "Dual BSD/GPL";
+
+/* runtime configuration, keys in enum tmt_cfg_key */
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY);
+    __uint(max_entries, TMT_CFG_MAX);
+    __type(key, __u32);
+    __type(value, __u32);
+} cfg SEC(".maps");
+
+/* per-CPU emitted events counter, one slot per record kind */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, TMT_EV_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+} ev_count SEC(".maps");
+
+/* per-CPU records lost because the ring buffer was full, per kind */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, TMT_EV_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+} drops SEC(".maps");
+
+/* per-CPU record sequence number, see tmt_event_hdr.seq */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u32);
+} seq SEC(".maps");
+
+/* ring buffer shared by every probe, records start with tmt_event_hdr */
+struct {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, 1 << 24);
+} events SEC(".maps");
+
+/* --rings: one ring buffer per group of CPUs, so producers on different
+ * groups do not share a lock. Userspace sizes the array, creates the
+ * rings (the inner map below is only a template) and sets TMT_CFG_RINGS */
+struct ring_slot {
+    __uint(type, BPF_MAP_TYPE_RINGBUF);
+    __uint(max_entries, 1 << 12);
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_ARRAY_OF_MAPS);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __array(values, struct ring_slot);
+} cpu_rings SEC(".maps");
+
+/* tids of the traced command and its descendants, see should_emit_pid;
+ * values in enum tmt_allow_state, size set with --filter-size */
+struct {
+    __uint(type, BPF_MAP_TYPE_HASH);
+    __type(key, __u32);
+    __type(value, __u8);
+    __uint(max_entries, 65536);
+} allow_pids SEC(".maps");
+
+/* per-CPU allow_pids updates, keys in enum tmt_filter_stat */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, TMT_FILTER_MAX);
+    __type(key, __u32);
+    __type(value, __u64);
+} filter_stats SEC(".maps");
+
+/* --summary: per-(tid,cpu) runtime, the CPU being the per-CPU slot;
+ * size set with --summary-size */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_HASH);
+    __type(key, __u32);
+    __type(value, struct tmt_rt_stat);
+    __uint(max_entries, 16384);
+} rt_stats SEC(".maps");
+
+/* per-CPU slices not accounted because rt_stats was full */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, __u64);
+} rt_drops SEC(".maps");
+
+/* switch-in of the task running on each CPU (--summary and slices) */
+struct {
+    __uint(type, BPF_MAP_TYPE_PERCPU_ARRAY);
+    __uint(max_entries, 1);
+    __type(key, __u32);
+    __type(value, struct tmt_cpu_run);
+} cpu_run SEC(".maps");
+
+/* last comm sent to userspace per tid, so switch records can omit it */
+struct tmt_comm {
+    char comm[TMT_COMM_LEN];
+};
+
+struct {
+    __uint(type, BPF_MAP_TYPE_LRU_HASH);
+    __type(key, __u32);
+    __type(value, struct tmt_comm);
+    __uint(max_entries, 16384);
+} tid_comm SEC(".maps");
+
+/* ring buffer of the group of cpu, the shared one without --rings */
+static __always_inline void *event_ring(__u32 cpu)
+{
+    __u32 n = cfg_get(&cfg, TMT_CFG_RINGS);
+    if (!n)
+        return &events;
+    __u32 slot = cpu % n;
+    void *rb = bpf_map_lookup_elem(&cpu_rings, &slot);
+    return rb ? rb : (void *)&events;
+}
+
+/* commit a reserved record; the kind is counted for the drain */
+static __always_inline void submit_event(void *rec, __u8 kind)
+{
+    __u32 cpu = ((struct tmt_event_hdr *)rec)->cpu;
+    inc_ev_count(&ev_count, kind);
+    bpf_ringbuf_submit(rec, rb_wakeup_flags(&cfg, event_ring(cpu)));
+}
+
+/* reserve a record and fill its header; a failed reserve still takes a
+ * sequence number, so userspace sees the gap, and is counted in drops */
+static __always_inline void *reserve_record(__u32 size, __u8 kind, __u32 cpu)
+{
+    __u32 zero = 0;
+    __u32 *next = bpf_map_lookup_elem(&seq, &zero);
+    __u32 s = next ? ++*next : 0;
+
+    struct tmt_event_hdr *h = bpf_ringbuf_reserve(event_ring(cpu), size, 0);
+    if (!h) {
+        inc_ev_count(&drops, kind);
+        return NULL;
+    }
+    h->kind = kind;
+    h->version = TMT_WIRE_VERSION;
+    h->cpu = cpu;
+    h->seq = s;
+    return h;
+}
+
+/* reserve a data_t in the ring buffer, filled from the current task */
+static __always_inline struct data_t *reserve_task_event(__u8 kind)
+{
+    struct data_t *d = reserve_record(sizeof(*d), kind, bpf_get_smp_processor_id());
+    if (!d)
+        return NULL;
+    fill_task_data(d);
+    return d;
+}
+
+/* ---- traced tasks ---- */
+
+/* allow_pids holds the tids of the traced command and of everything it
+ * forks (see handle_sched_fork); with the filter off every tid passes */
+static __always_inline bool should_emit_pid(u32 pid)
+{
+    if (cfg_get(&cfg, TMT_CFG_USE_FILTER) == 0)
+        return true;
+
+    u8 *ok = bpf_map_lookup_elem(&allow_pids, &pid);
+    return ok && *ok != 0;
+}
+
+/* checked by every probe before it reserves ring buffer space */
+static __always_inline bool current_traced(void)
+{
+    return should_emit_pid((u32)bpf_get_current_pid_tgid());
+}
+
+/* ---- execve ---- */
+
+SEC("tracepoint/syscalls/sys_enter_execve")
+int trace_execve(struct trace_event_raw_sys_enter *ctx)
+{
+    if (!producer_enabled(&cfg) || !current_traced())
+        return 0;
+
+    struct data_t *d = reserve_task_event(TMT_EV_EXECVE_ENTER);
+    if (!d)
+        return 0;
+    submit_event(d, TMT_EV_EXECVE_ENTER);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_execve")
+int trace_execve_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    if (!producer_enabled(&cfg) || !current_traced())
+        return 0;
+
+    struct data_t *d = reserve_task_event(TMT_EV_EXECVE_EXIT);
+    if (!d)
+        return 0;
+    submit_event(d, TMT_EV_EXECVE_EXIT);
+    return 0;
+}
+
+/* ---- fork / clone / clone3 ---- */
+
+SEC("tracepoint/sched/sched_process_fork")
+int handle_sched_fork(struct trace_event_raw_sched_process_fork *ctx)
+{
+    if (!producer_enabled(&cfg))
+        return 0;
+
+    /* the child of a traced task is traced, from before it first runs */
+    u32 parent = ctx->parent_pid;
+    if (!should_emit_pid(parent))
+        return 0;
+    if (cfg_get(&cfg, TMT_CFG_USE_FILTER)) {
+        u32 child = ctx->child_pid;
+        u8 traced = TMT_ALLOW_TRACED;
+        if (bpf_map_update_elem(&allow_pids, &child, &traced, BPF_ANY) == 0)
+            inc_ev_count(&filter_stats, TMT_FILTER_ADDED);
+        else
+            inc_ev_count(&filter_stats, TMT_FILTER_FULL);
+    }
+
+    struct data_t *d = reserve_task_event(TMT_EV_FORK);
+    if (!d)
+        return 0;
+
+    d->parent_pid = ctx->parent_pid;
+    d->pid = ctx->parent_pid;
+    d->child_pid = ctx->child_pid;
+
+    submit_event(d, TMT_EV_FORK);
+    return 0;
+}
+
+static __always_inline int emit_clone_exit(struct trace_event_raw_sys_exit *ctx, __u8 kind)
+{
+    if (!producer_enabled(&cfg) || !current_traced())
+        return 0;
+
+    long child = ctx->ret;
+    if (child <= 0)
+        return 0;
+
+    struct data_t *d = reserve_task_event(kind);
+    if (!d)
+        return 0;
+    d->child_pid = (int)child;
+
+    submit_event(d, kind);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_exit_clone")
+int trace_clone_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    return emit_clone_exit(ctx, TMT_EV_CLONE);
+}
+
+SEC("tracepoint/syscalls/sys_exit_clone3")
+int trace_clone3_exit(struct trace_event_raw_sys_exit *ctx)
+{
+    return emit_clone_exit(ctx, TMT_EV_CLONE3);
+}
+
+/* ---- exit / exit_group ---- */
+
+SEC("tracepoint/syscalls/sys_enter_exit")
+int trace_exit_enter(struct trace_event_raw_sys_enter *ctx)
+{
+    if (!producer_enabled(&cfg) || !current_traced())
+        return 0;
+
+    struct data_t *d = reserve_task_event(TMT_EV_EXIT);
+    if (!d)
+        return 0;
+
+    /* the exiting thread, not its group */
+    d->pid = d->tid;
+
+    submit_event(d, TMT_EV_EXIT);
+    return 0;
+}
+
+SEC("tracepoint/syscalls/sys_enter_exit_group")
+int trace_exit_group(struct trace_event_raw_sys_enter *ctx)
+{
+    if (!producer_enabled(&cfg) || !current_traced())
+        return 0;
+
+    struct data_t *d = reserve_task_event(TMT_EV_EXIT_GROUP);
+    if (!d)
+        return 0;
+
+    d->parent_pid = d->tgid;
+
+    submit_event(d, TMT_EV_EXIT_GROUP);
+    return 0;
+}
+
+/* ---- sched_switch ---- */
+
+/* send a comm_event_t if userspace does not know this comm for tid yet;
+ * with only_unknown, a tid that already has a comm is left alone */
+static __always_inline void sync_comm(u32 cpu, u32 tid, const char *src, bool only_unknown)
+{
+    struct tmt_comm *known = bpf_map_lookup_elem(&tid_comm, &tid);
+    if (known && only_unknown)
+        return;
+
+    struct tmt_comm cur = {};
+    bpf_probe_read_kernel_str(cur.comm, sizeof(cur.comm), src);
+    if (known) {
+        const __u64 *a = (const __u64 *)known->comm;
+        const __u64 *b = (const __u64 *)cur.comm;
+        if (a[0] == b[0] && a[1] == b[1])
+            return;
+    }
+
+    struct comm_event_t *c = reserve_record(sizeof(*c), TMT_EV_COMM, cpu);
+    if (!c)
+        return;
+    c->tid = tid;
+    c->pad = 0;
+    __builtin_memcpy(c->comm, cur.comm, sizeof(c->comm));
+    submit_event(c, TMT_EV_COMM);
+    bpf_map_update_elem(&tid_comm, &tid, &cur, BPF_ANY);
+}
+
+/* start timing next on this CPU, if it is traced */
+/* sched_switch reports a preempted task as TASK_REPORT_MAX (0x100) since
+ * 4.14, as 0 before; anything else means prev went to sleep */
+#define TMT_TASK_REPORT_MAX 0x100
+
+static __always_inline bool switched_out_blocked(long prev_state)
+{
+    return prev_state != 0 && !(prev_state & TMT_TASK_REPORT_MAX);
+}
+
+static __always_inline void track_switch_in(struct tmt_cpu_run *run,
+                                            struct trace_event_raw_sched_switch *ctx,
+                                            u64 ts, u32 next)
+{
+    if (should_emit_pid(next)) {
+        run->ts  = ts;
+        run->tid = next;
+        bpf_probe_read_kernel_str(run->comm, sizeof(run->comm), ctx->next_comm);
+    } else {
+        run->ts  = 0;
+    }
+}
+
+/* fold the on-CPU time of prev into rt_stats and start timing next */
+static __always_inline void account_switch(struct trace_event_raw_sched_switch *ctx,
+                                           u64 ts, u32 prev, u32 next)
+{
+    u32 zero = 0;
+    struct tmt_cpu_run *run = bpf_map_lookup_elem(&cpu_run, &zero);
+    if (!run)
+        return;
+
+    if (run->ts && run->tid == prev) {
+        struct tmt_rt_stat *st = bpf_map_lookup_elem(&rt_stats, &prev);
+        if (!st) {
+            struct tmt_rt_stat init = {};
+            bpf_map_update_elem(&rt_stats, &prev, &init, BPF_NOEXIST);
+            st = bpf_map_lookup_elem(&rt_stats, &prev);
+            if (!st)
+                inc_ev_count(&rt_drops, 0);
+        }
+        if (st) {
+            if (!st->comm[0])
+                bpf_probe_read_kernel_str(st->comm, sizeof(st->comm), ctx->prev_comm);
+            if (ts > run->ts)
+                st->oncpu_ns += ts - run->ts;
+            st->switches++;
+            if (switched_out_blocked(ctx->prev_state))
+                st->voluntary++;
+            else
+                st->involuntary++;
+        }
+    }
+
+    track_switch_in(run, ctx, ts, next);
+}
+
+/* emit the slice prev just finished and start timing next */
+static __always_inline void emit_slice(struct trace_event_raw_sched_switch *ctx,
+                                       u64 ts, u32 cpu, u32 prev, u32 next)
+{
+    u32 zero = 0;
+    struct tmt_cpu_run *run = bpf_map_lookup_elem(&cpu_run, &zero);
+    if (!run)
+        return;
+
+    if (should_emit_pid(prev)) {
+        __u64 start = 0;
+        if (run->ts && run->tid == prev)
+            start = run->ts;
+        else
+            /* switch-in predates tracing, userspace only keeps the timestamp */
+            sync_comm(cpu, prev, ctx->prev_comm, true);
+
+        struct slice_event_t *e = reserve_record(sizeof(*e), TMT_EV_SLICE, cpu);
+        if (e) {
+            e->pad = 0;
+            e->tid_flags = (prev & TMT_SW_TID_MASK) | (switched_out_blocked(ctx->prev_state) ? TMT_SW_BLOCKED : 0);
+            e->start = start;
+            e->end = ts;
+            submit_event(e, TMT_EV_SLICE);
+        }
+    }
+
+    track_switch_in(run, ctx, ts, next);
+    if (run->ts)
+        sync_comm(cpu, next, ctx->next_comm, false);
+}
+
+static __always_inline void emit_switch(u32 cpu, u32 tid_flags, u64 ts)
+{
+    struct switch_event_t *e = reserve_record(sizeof(*e), TMT_EV_SWITCH, cpu);
+    if (!e)
+        return;
+    e->tid_flags = tid_flags;
+    e->pad = 0;
+    e->ts = ts;
+    submit_event(e, TMT_EV_SWITCH);
+}
+
+/* TMT_SWITCH_EVENTS: a switch-out record for prev, a switch-in for next */
+static __always_inline void emit_switches(struct trace_event_raw_sched_switch *ctx,
+                                          u64 ts, u32 cpu, u32 prev, u32 next)
+{
+    /* emit switch-out for prev */
+    if (should_emit_pid(prev)) {
+        sync_comm(cpu, prev, ctx->prev_comm, true);
+        emit_switch(cpu, (prev & TMT_SW_TID_MASK) |
+                         (switched_out_blocked(ctx->prev_state) ? TMT_SW_BLOCKED : 0), ts);
+    }
+
+    /* emit switch-in for next */
+    if (should_emit_pid(next)) {
+        sync_comm(cpu, next, ctx->next_comm, false);
+        emit_switch(cpu, (next & TMT_SW_TID_MASK) | TMT_SW_IN, ts);
+    }
+}
+
+/* prev_state bits of a task switched out for the last time: its
+ * exit_state, EXIT_DEAD or EXIT_ZOMBIE, as the tracepoint reports them */
+#define TMT_PREV_EXITED (0x10 | 0x20)
+
+/* an exiting task can still sleep or be preempted between
+ * sched_process_exit and its final switch-out, it is kept until then */
+static __always_inline void forget_exited(u32 prev, long prev_state)
+{
+    if (!(prev_state & TMT_PREV_EXITED))
+        return;
+    u8 *st = bpf_map_lookup_elem(&allow_pids, &prev);
+    if (st && *st == TMT_ALLOW_EXITING &&
+        bpf_map_delete_elem(&allow_pids, &prev) == 0)
+        inc_ev_count(&filter_stats, TMT_FILTER_REMOVED);
+}
+
+SEC("tracepoint/sched/sched_switch")
+int trace_sched_switch(struct trace_event_raw_sched_switch *ctx)
+{
+    if (!producer_enabled(&cfg))
+        return 0;
+
+    u64 ts  = bpf_ktime_get_ns();
+    u32 cpu = bpf_get_smp_processor_id();
+    u32 prev = ctx->prev_pid;
+    u32 next = ctx->next_pid;
+
+    u32 mode = cfg_get(&cfg, TMT_CFG_SWITCH_MODE);
+    if (mode == TMT_SWITCH_SUMMARY)
+        account_switch(ctx, ts, prev, next);
+    else if (mode == TMT_SWITCH_SLICES)
+        emit_slice(ctx, ts, cpu, prev, next);
+    else
+        emit_switches(ctx, ts, cpu, prev, next);
+
+    forget_exited(prev, ctx->prev_state);
+    return 0;
+}
+
+/* the tid stays in allow_pids until its final switch-out, see forget_exited */
+SEC("tracepoint/sched/sched_process_exit")
+int mark_exit(void *ctx)
+{
+    if (cfg_get(&cfg, TMT_CFG_USE_FILTER) == 0)
+        return 0;
+
+    u32 tid = (u32)bpf_get_current_pid_tgid();
+    u8 *st = bpf_map_lookup_elem(&allow_pids, &tid);
+    if (st)
+        *st = TMT_ALLOW_EXITING;
+    return 0;
+}
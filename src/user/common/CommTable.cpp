@@ -0,0 +1,56 @@
+#include "CommTable.hpp"
+#include <cstring>
+
+CommTable& CommTable::instance() {
+    static CommTable table;
+    return table;
+}
+
+CommTable::CommTable() {
+    names_.emplace_back();
+    ids_.emplace(std::string(), 0);
+}
+
+/* names are never dropped, so a thread can remember the ids it has seen
+ * and skip the lock (and the string) for the comms it meets again */
+uint32_t CommTable::intern(const char* comm, size_t maxlen) {
+    constexpr size_t SLOTS = 256, LEN = 16;
+    struct Slot { char comm[LEN]; uint32_t id; };
+    static thread_local Slot cache[SLOTS];
+
+    size_t len = strnlen(comm, maxlen);
+    if (len >= LEN) return intern(std::string(comm, len));
+
+    char key[LEN] = {};
+    memcpy(key, comm, len);
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < len; ++i) h = (h ^ (uint8_t)key[i]) * 16777619u;
+
+    Slot& s = cache[h % SLOTS];
+    if (s.id && memcmp(s.comm, key, LEN) == 0) return s.id;
+    uint32_t id = intern(std::string(key, len));
+    memcpy(s.comm, key, LEN);
+    s.id = id;
+    return id;
+}
+
+uint32_t CommTable::intern(const std::string& comm) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    auto it = ids_.find(comm);
+    if (it != ids_.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(names_.size());
+    names_.push_back(comm);
+    ids_.emplace(comm, id);
+    return id;
+}
+
+const std::string& CommTable::name(uint32_t id) const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    if (id >= names_.size()) return names_.front();
+    return names_[id];
+}
+
+size_t CommTable::size() const {
+    std::lock_guard<std::mutex> lk(mtx_);
+    return names_.size();
+}
@@ -0,0 +1,54 @@
+#include "CsvWriter.hpp"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+CsvWriter::CsvWriter(size_t flush_bytes)
+: flush_bytes_(flush_bytes) {}
+
+CsvWriter::~CsvWriter() {
+    close();
+}
+
+bool CsvWriter::open(const std::string& path) {
+    close();
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        fprintf(stderr, "[csv] open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    path_ = path;
+    failed_ = false;
+    buf_.clear();
+    return true;
+}
+
+void CsvWriter::write_out(const char* p, size_t n) {
+    while (n && !failed_) {
+        ssize_t w = ::write(fd_, p, n);
+        if (w < 0) {
+            if (errno == EINTR) continue;
+            fprintf(stderr, "[csv] write to %s failed: %s\n", path_.c_str(), strerror(errno));
+            failed_ = true;
+            break;
+        }
+        p += w;
+        n -= (size_t)w;
+    }
+}
+
+void CsvWriter::flush() {
+    if (fd_ < 0) return;
+    write_out(buf_.data(), buf_.size());
+    buf_.clear();
+}
+
+bool CsvWriter::close() {
+    if (fd_ < 0) return !failed_;
+    flush();
+    if (::close(fd_) != 0) failed_ = true;
+    fd_ = -1;
+    return !failed_;
+}
@@ -0,0 +1,44 @@
+#include "TaskGraph.hpp"
+#include <cstdio>
+#include <exception>
+
+TaskGraph::Id TaskGraph::add(std::string name, std::function<void()> fn, const std::vector<Id>& deps) {
+    Id id = tasks_.size();
+    tasks_.push_back(Task{std::move(name), std::move(fn), {}, deps.size()});
+    for (Id d : deps) tasks_[d].next.push_back(id);
+    return id;
+}
+
+void TaskGraph::start(ThreadPool& pool, Id id) {
+    pool.submit([this, &pool, id]() {
+        Task& t = tasks_[id];
+        try {
+            t.fn();
+        } catch (const std::exception& e) {
+            fprintf(stderr, "[tasks] %s failed: %s\n", t.name.c_str(), e.what());
+        }
+
+        // notify under the lock: run() may return, and the graph go away,
+        // as soon as the last task is counted
+        std::vector<Id> ready;
+        {
+            std::lock_guard<std::mutex> lk(mtx_);
+            for (Id n : t.next)
+                if (--tasks_[n].waiting == 0) ready.push_back(n);
+            ++done_;
+            cv_.notify_all();
+        }
+        for (Id n : ready) start(pool, n);
+    });
+}
+
+void TaskGraph::run(ThreadPool& pool) {
+    done_ = 0;
+    std::vector<Id> roots;
+    for (Id i = 0; i < tasks_.size(); ++i)
+        if (!tasks_[i].waiting) roots.push_back(i);
+    for (Id i : roots) start(pool, i);
+
+    std::unique_lock<std::mutex> lk(mtx_);
+    cv_.wait(lk, [this]() { return done_ == tasks_.size(); });
+}
@@ -0,0 +1,49 @@
+#include "WallClock.hpp"
+#include <cstdio>
+#include <ctime>
+
+static uint64_t clock_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+const WallClock& WallClock::instance() {
+    static WallClock clock;
+    return clock;
+}
+
+WallClock::WallClock() {
+    // bracket a CLOCK_REALTIME read between two CLOCK_MONOTONIC reads and
+    // keep the tightest of a few tries
+    uint64_t best = UINT64_MAX;
+    for (int i = 0; i < 8; ++i) {
+        uint64_t m0 = clock_ns(CLOCK_MONOTONIC);
+        uint64_t rt = clock_ns(CLOCK_REALTIME);
+        uint64_t m1 = clock_ns(CLOCK_MONOTONIC);
+        if (m1 - m0 < best) {
+            best = m1 - m0;
+            offset_ns_ = rt - (m0 + (m1 - m0) / 2);
+        }
+    }
+}
+
+std::string WallClock::format(uint64_t mono_ns) const {
+    uint64_t rt = to_realtime_ns(mono_ns);
+    time_t sec = (time_t)(rt / 1000000000ULL);
+
+    // consecutive events mostly share the second, reuse its formatted part
+    thread_local time_t cached_sec = -1;
+    thread_local char cached[32];
+    if (sec != cached_sec) {
+        struct tm tmv;
+        localtime_r(&sec, &tmv);
+        strftime(cached, sizeof(cached), "%Y-%m-%d %H:%M:%S", &tmv);
+        cached_sec = sec;
+    }
+
+    char out[48];
+    snprintf(out, sizeof(out), "%s.%06lu", cached,
+             (unsigned long)((rt / 1000ULL) % 1000000ULL));
+    return std::string(out);
+}
@@ -1,84 +1,74 @@
 #include "BaseHandler.hpp"
+#include "CommTable.hpp"
 #include <bpf/bpf.h>
-#include <sys/sysinfo.h>
-#include <ctime>
-#include <unistd.h>
+#include <cerrno>
+#include <cstring>
 #include <cstdio>
 
-void BaseHandler::start() {
-    running_.store(true);
-    poll_thread_ = std::thread([this](){
-        while (running_.load(std::memory_order_relaxed)) {
-            if (rb1_) {
-                int ret = ring_buffer__poll(rb1_, timeout_ms_);
-                if (ret < 0 && ret != -EINTR)
-                    fprintf(stderr, "[%s] rb1 poll err=%d\n", name_.c_str(), ret);
-            }
-            if (rb2_) {
-                int ret = ring_buffer__poll(rb2_, timeout_ms_);
-                if (ret < 0 && ret != -EINTR)
-                    fprintf(stderr, "[%s] rb2 poll err=%d\n", name_.c_str(), ret);
-            }
-        }
-    });
-}
+thread_local unsigned BaseHandler::t_slot_ = 0;
 
-void BaseHandler::stop() {
-    if (!running_.exchange(false)) return;
-    if (poll_thread_.joinable()) poll_thread_.join();
-    if (rb1_) { ring_buffer__free(rb1_); rb1_ = nullptr; }
-    if (rb2_) { ring_buffer__free(rb2_); rb2_ = nullptr; }
+std::vector<Event> BaseHandler::take_events() {
+    size_t n = 0;
+    for (const auto& s : stored_) n += s.size();
+    std::vector<Event> out;
+    out.reserve(n);
+    for (auto& s : stored_) {
+        s.for_each([&](const Event& e) { out.push_back(e); });
+        s.reset();
+    }
+    return out;
 }
 
-void BaseHandler::drain_until(uint64_t total_expected) {
-    const int MAX_IDLE = 5000;
-    int idle = 0;
-    while (read_events_.load() < total_expected) {
-        if (rb1_) ring_buffer__poll(rb1_, 0);
-        if (rb2_) ring_buffer__poll(rb2_, 0);
-        if (++idle > MAX_IDLE) break;
-        usleep(1000); 
+bool BaseHandler::attach_tracepoint(struct bpf_object* obj, const char* prog_name,
+                                    const char* category, const char* tp_name) {
+    bpf_program *prog = bpf_object__find_program_by_name(obj, prog_name);
+    if (!prog) {
+        fprintf(stderr, "[%s] program %s not found\n", name_.c_str(), prog_name);
+        return false;
+    }
+    bpf_link *link = bpf_program__attach_tracepoint(prog, category, tp_name);
+    if (!link) {
+        fprintf(stderr, "[%s] attach %s/%s failed: %s\n",
+                name_.c_str(), category, tp_name, strerror(errno));
+        return false;
     }
+    links_.push_back(link);
+    return true;
 }
 
-std::vector<Event> BaseHandler::collect() {
-    std::lock_guard<std::mutex> lk(mtx_);
-    return events_;
+void BaseHandler::print_wakeup_stats() const {
+    uint64_t n = read_total(), w = wakeups();
+    fprintf(stderr, "[%s] %llu events in %llu wakeups (%.4f wakeups/event)\n",
+            name_.c_str(), (unsigned long long)n, (unsigned long long)w,
+            n ? (double)w / n : 0.0);
 }
 
-void BaseHandler::set_ring_buffers(struct ring_buffer* rb1, struct ring_buffer* rb2) {
-    rb1_ = rb1;
-    rb2_ = rb2;
+void BaseHandler::detach() {
+    for (auto* l : links_) bpf_link__destroy(l);
+    links_.clear();
 }
 
-int BaseHandler::set_cfg_enabled_map(int fd) {
-    uint32_t key = 0, one = 1;
-    return bpf_map_update_elem(fd, &key, &one, BPF_ANY);
+void BaseHandler::store(const Event& e) {
+    if (keep_) stored_[t_slot_].push(e);
+    if (sink_) sink_->on_event(e);
 }
 
-int BaseHandler::freeze_cfg_enabled_map(int fd) {
-    uint32_t key = 0, zero = 0;
-    return bpf_map_update_elem(fd, &key, &zero, BPF_ANY);
-}
+int BaseHandler::on_task_sample(EventKind kind, void *data, size_t len) {
+    if (len < sizeof(data_t)) return 0;
+    read_events_.fetch_add(1, std::memory_order_relaxed);
+    auto* ev = (const data_t*)data;
 
-uint64_t BaseHandler::snapshot_evcount_percpu(int fd) {
-    int n = libbpf_num_possible_cpus();
-    std::vector<uint64_t> vals(n);
-    uint32_t key = 0;
-    if (bpf_map_lookup_elem(fd, &key, vals.data()) != 0)
-        return read_events_.load();
-    uint64_t tot = 0;
-    for (auto v : vals) tot += v;
-    return tot;
-}
+    Event e;
+    e.kind = kind;
+    e.cpu = ev->hdr.cpu;
+    e.parent_pid = ev->parent_pid;
+    e.pid = ev->pid;
+    e.child_pid = ev->child_pid;
+    e.tid = ev->tid;
+    e.tgid = ev->tgid;
+    e.comm = CommTable::instance().intern(ev->command, sizeof(ev->command));
+    e.timestamp = ev->timestamp;
 
-std::string BaseHandler::human_ts(uint64_t ts_ns) {
-    struct sysinfo si; sysinfo(&si);
-    time_t now = time(NULL), boot = now - si.uptime;
-    time_t sec = boot + (time_t)(ts_ns / 1000000000ULL);
-    struct tm tmv; localtime_r(&sec, &tmv);
-    char buf[64]; strftime(buf, sizeof(buf), "%Y-%m-%d %H:%M:%S", &tmv);
-    char out[96]; snprintf(out, sizeof(out), "%s.%06lu", buf,
-                           (unsigned long)((ts_ns / 1000ULL) % 1000000ULL));
-    return std::string(out);
+    store(e);
+    return 0;
 }
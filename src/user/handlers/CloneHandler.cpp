@@ -1,135 +1,12 @@
 #include "CloneHandler.hpp"
-#include <bpf/libbpf.h>
-#include <bpf/bpf.h>
-#include <unistd.h>
-#include <libgen.h>
-#include <limits.h>
-#include <cstring>
-#include <cerrno>
-#include <iostream>
 
-#pragma pack(push,1)
-struct data_t {
-    uint32_t parent_pid;
-    uint32_t pid;
-    uint32_t child_pid;
-    uint32_t pgid;
-    uint32_t tid;
-    uint32_t tgid;
-    char     command[16];
-    uint64_t timestamp;
-};
-#pragma pack(pop)
+CloneHandler::CloneHandler()
+: BaseHandler("clone", { TMT_EV_CLONE }) {}
 
-CloneHandler::CloneHandler(int poll_timeout_ms)
-: BaseHandler("fork", poll_timeout_ms) {}
-
-CloneHandler::~CloneHandler() {
-    stop();
-    detach();
-    if (obj_) bpf_object__close(obj_);
-}
-
-std::string CloneHandler::resolve_bpf_obj_path() const {
-    char exe_path[PATH_MAX]{};
-    ssize_t n = readlink("/proc/self/exe", exe_path, sizeof(exe_path)-1);
-    if (n <= 0) return "./bin/clone.bpf.o";
-    exe_path[n] = '\0';
-    return std::string(dirname(exe_path)) + "/clone.bpf.o";
-}
-
-int CloneHandler::sample_cb(void *ctx, void *data, size_t len) {
-    auto *c = reinterpret_cast<CloneHandler::RbCtx*>(ctx);
-    return c->self->on_sample_with_tag(c->tag, data, len);
-}
-
-bool CloneHandler::install() {
-    libbpf_set_strict_mode(LIBBPF_STRICT_ALL);
-    bpf_object_open_opts opts{};
-    opts.sz = sizeof(opts);
-    opts.btf_custom_path = "/sys/kernel/btf/vmlinux";
-
-    std::string objp = resolve_bpf_obj_path();
-    obj_ = bpf_object__open_file(objp.c_str(), &opts);
-    if (!obj_) {
-        fprintf(stderr, "[clone] open_file failed: %s\n", objp.c_str());
-        return false;
-    }
-    int err = bpf_object__load(obj_);
-    if (err) {
-        const char *libbpf_err = strerror(-err);
-        fprintf(stderr, "[clone] load failed: %s (err=%d)\n",
-                libbpf_err?libbpf_err:"unknown", err);
-        return false;
-    }
-
-    map_cfg_ = bpf_object__find_map_fd_by_name(obj_, "cfg_enabled");
-    map_ev_  = bpf_object__find_map_fd_by_name(obj_, "ev_count");
-    map_rb_  = bpf_object__find_map_fd_by_name(obj_, "clone_output");
-    if (map_cfg_ < 0 || map_ev_ < 0 || map_rb_ < 0) {
-        fprintf(stderr, "[clone] missing maps (cfg_enabled/ev_count/clone_output)\n");
-        return false;
-    }
-
-    auto *prog = bpf_object__find_program_by_name(obj_, "trace_clone_exit");
-    if (!prog) {
-        fprintf(stderr, "[clone] program trace_clone_exit not found\n");
-        return false;
-    }
-    link_ = bpf_program__attach_tracepoint(prog, "syscalls", "sys_exit_clone");
-    if (!link_) {
-        fprintf(stderr, "[clone] attach sys_exit_clone failed: %s\n", strerror(errno));
-        return false;
-    }
-
-    set_cfg_enabled_map(map_cfg_);
-
-    rb_ctx_ = { this, "fork" }; 
-    rb_ = ring_buffer__new(map_rb_, sample_cb, &rb_ctx_, NULL);
-    if (!rb_) {
-        fprintf(stderr, "[clone] ring_buffer__new failed\n");
-        return false;
-    }
-
-    start();
-    return true;
-}
-
-void CloneHandler::detach() {
-    if (link_) { bpf_link__destroy(link_); link_ = nullptr; }
-    if (rb_) { ring_buffer__free(rb_); rb_ = nullptr; }
-}
-
-void CloneHandler::freeze_producer() {
-    freeze_cfg_enabled_map(map_cfg_);
-}
-
-uint64_t CloneHandler::snapshot_total() {
-    return snapshot_evcount_percpu(map_ev_);
+bool CloneHandler::install(struct bpf_object* obj) {
+    return attach_tracepoint(obj, "trace_clone_exit", "syscalls", "sys_exit_clone");
 }
 
 int CloneHandler::on_sample(void *data, size_t len) {
-    return on_sample_with_tag("fork", data, len);
-}
-
-int CloneHandler::on_sample_with_tag(const char* tag, void *data, size_t len) {
-    if (len < sizeof(data_t)) return 0;
-    read_events_.fetch_add(1, std::memory_order_relaxed);
-    auto* ev = (const data_t*)data;
-
-    Event e;
-    e.event = tag ? std::string(tag) : std::string("fork");
-    e.parent_pid = ev->parent_pid;
-    e.pid = ev->pid;
-    e.child_pid = ev->child_pid;
-    e.pgid = ev->pgid;
-    e.tid = ev->tid;
-    e.tgid = ev->tgid;
-    e.command = std::string(ev->command);
-    e.timestamp = ev->timestamp;
-    e.timestamp_human = BaseHandler::human_ts(ev->timestamp);
-
-    std::lock_guard<std::mutex> lk(mtx_);
-    events_.push_back(std::move(e));
-    return 0;
+    return on_task_sample(EventKind::Clone, data, len);
 }
@@ -1,214 +1,187 @@
 #include "SwitchHandler.hpp"
 #include "BaseHandler.hpp"
+#include "CommTable.hpp"
 #include <bpf/bpf.h>
 #include <bpf/libbpf.h>
 #include <linux/bpf.h>
 
 #include <unistd.h>
-#include <dirent.h>
 #include <limits.h>
+#include <time.h>
 #include <cstdio>
 #include <cstring>
 #include <string>
 #include <iostream>
-
-#pragma pack(push,1)
-struct run_event_t {
-    uint64_t ts;
-    uint32_t cpu;
-    uint32_t pid;
-    uint32_t type;
-    uint32_t reason;
-    char     comm[16];
-    uint32_t parent_pid, child_pid, pgid, tid, tgid;
-    char     command[16];
-    uint64_t timestamp;
-};
-#pragma pack(pop)
-
-static int sample_cb(void *ctx, void *data, size_t len) {
-    return reinterpret_cast<SwitchHandler*>(ctx)->on_sample(data, len);
-}
-
-static uint32_t read_pid_file(const char* path) {
-    FILE* f = fopen(path, "re");
-    if (!f) return 0;
-    unsigned long x = 0;
-    if (fscanf(f, "%lu", &x) != 1) { fclose(f); return 0; }
-    fclose(f);
-    return (uint32_t)x;
-}
-
-static void add_tid_if_any(int map_allow_fd, uint32_t tid) {
-    if (!tid) return;
-    uint8_t one = 1;
-    bpf_map_update_elem(map_allow_fd, &tid, &one, BPF_ANY);
-}
-
-static void add_all_threads_of_pid(int map_allow_fd, uint32_t pid) {
-    if (!pid) return;
-    char path[64];
-    snprintf(path, sizeof(path), "/proc/%u/task", pid);
-    DIR* d = opendir(path);
-    if (!d) {
-        add_tid_if_any(map_allow_fd, pid);
-        return;
-    }
-    struct dirent* de;
-    while ((de = readdir(d)) != nullptr) {
-        if (de->d_name[0] == '.') continue;
-        unsigned long tid = strtoul(de->d_name, nullptr, 10);
-        if (tid > 0 && tid <= 0xfffffffful)
-            add_tid_if_any(map_allow_fd, (uint32_t)tid);
+#include <map>
+
+SwitchHandler::SwitchHandler()
+: BaseHandler("switch", { TMT_EV_SWITCH, TMT_EV_SLICE, TMT_EV_COMM }) {}
+
+bool SwitchHandler::install(struct bpf_object* obj) {
+    if (mode_ != TMT_SWITCH_EVENTS) {
+        int map_cfg = bpf_object__find_map_fd_by_name(obj, "cfg");
+        map_rt_  = bpf_object__find_map_fd_by_name(obj, "rt_stats");
+        map_run_ = bpf_object__find_map_fd_by_name(obj, "cpu_run");
+        uint32_t k = TMT_CFG_SWITCH_MODE;
+        if (map_cfg < 0 || map_rt_ < 0 || map_run_ < 0 ||
+            bpf_map_update_elem(map_cfg, &k, &mode_, BPF_ANY) != 0) {
+            fprintf(stderr, "[switch] failed to set switch mode %u\n", mode_);
+            return false;
+        }
     }
-    closedir(d);
-}
-
-SwitchHandler::SwitchHandler(int poll_timeout_ms)
-: BaseHandler("switch", poll_timeout_ms) {}
-
-SwitchHandler::~SwitchHandler() {
-    stop();
-    detach();
-    if (obj_) bpf_object__close(obj_);
-}
 
-std::string SwitchHandler::resolve_bpf_obj_path() const {
-    char exe_path[PATH_MAX]{};
-    ssize_t n = readlink("/proc/self/exe", exe_path, sizeof(exe_path)-1);
-    if (n <= 0) return "./bin/sched_switch.bpf.o";
-    exe_path[n] = '\0';
-    char* slash = strrchr(exe_path, '/');
-    if (!slash) return "./bin/sched_switch.bpf.o";
-    *slash = '\0';
-    return std::string(exe_path) + "/sched_switch.bpf.o";
+    return attach_tracepoint(obj, "trace_sched_switch", "sched", "sched_switch");
 }
 
-bool SwitchHandler::install() {
-    libbpf_set_strict_mode(LIBBPF_STRICT_ALL);
-
-    bpf_object_open_opts opts{};
-    opts.sz = sizeof(opts);
-    opts.btf_custom_path = "/sys/kernel/btf/vmlinux";
-
-    std::string objp = resolve_bpf_obj_path();
-    obj_ = bpf_object__open_file(objp.c_str(), &opts);
-    if (!obj_) {
-        fprintf(stderr, "[switch] open_file failed: %s\n", objp.c_str());
-        return false;
-    }
-    int err = bpf_object__load(obj_);
-    if (err) {
-        fprintf(stderr, "[switch] load failed: %s\n", strerror(-err));
-        return false;
+int SwitchHandler::on_sample(void *data, size_t len) {
+    switch (static_cast<const tmt_event_hdr*>(data)->kind) {
+        case TMT_EV_SLICE: return on_slice(data, len);
+        case TMT_EV_COMM:  return on_comm(data, len);
+        default: break;
     }
+    if (len < sizeof(switch_event_t)) return 0;
+    read_events_.fetch_add(1, std::memory_order_relaxed);
+    const switch_event_t* ev = reinterpret_cast<const switch_event_t*>(data);
+    uint32_t tid = ev->tid_flags & TMT_SW_TID_MASK;
 
-    map_cfg_ = bpf_object__find_map_fd_by_name(obj_, "cfg_enabled");
-    map_ev_  = bpf_object__find_map_fd_by_name(obj_, "ev_count");
-    map_rb_  = bpf_object__find_map_fd_by_name(obj_, "sched_output");
-    
-    int map_allow_ = bpf_object__find_map_fd_by_name(obj_, "allow_pids");
-    int map_usef_  = bpf_object__find_map_fd_by_name(obj_, "cfg_useFilter");
-    if (map_cfg_ < 0 || map_ev_ < 0 || map_rb_ < 0 || map_allow_ < 0 || map_usef_ < 0) {
-        fprintf(stderr, "[switch] missing maps\n");
-        return false;
-    }
+    Event e;
+    e.kind   = (ev->tid_flags & TMT_SW_IN) ? EventKind::Run : EventKind::Desched;
+    e.pid    = tid;
+    e.tid    = tid;
+    e.cpu    = ev->hdr.cpu;
+    e.reason = (ev->tid_flags & TMT_SW_BLOCKED) ? SwitchReason::Sleep : SwitchReason::Preempt;
+    e.comm   = comm_of(tid);
+    e.timestamp = ev->ts;
 
-    {
-        uint32_t k = 0, on = 1;
-        if (bpf_map_update_elem(map_usef_, &k, &on, BPF_ANY) != 0)
-            fprintf(stderr, "[switch] failed to enable pid filter\n");
-    }
+    store(e);
+    return 0;
+}
 
-    uint32_t shell_pid = shell_pid_hint_;
-    uint32_t cmd_pid   = cmd_pid_hint_;
-
-    if (!shell_pid && !cmd_pid) {
-        uint32_t k = 0, off = 0;
-        if (bpf_map_update_elem(map_usef_, &k, &off, BPF_ANY) != 0)
-            fprintf(stderr, "[switch] failed to disable pid filter\n");
-    } else {
-        if (shell_pid) add_tid_if_any(map_allow_, shell_pid);
-        if (cmd_pid) {
-            add_tid_if_any(map_allow_, cmd_pid);
-            add_all_threads_of_pid(map_allow_, cmd_pid);
-            fprintf(stderr, "[switch] allow tgid=%u and its threads\n", cmd_pid);
+std::vector<RuntimeStat> SwitchHandler::read_summary() const {
+    std::vector<RuntimeStat> out;
+    if (map_rt_ < 0) return out;
+
+    int ncpu = libbpf_num_possible_cpus();
+    if (ncpu <= 0) return out;
+
+    // (tid,cpu) -> index in out, used to fold in the still-running tasks
+    std::map<std::pair<uint32_t, uint32_t>, size_t> idx;
+    std::vector<tmt_rt_stat> vals(ncpu);
+
+    uint32_t key = 0, next = 0;
+    uint32_t* prev = nullptr;
+    while (bpf_map_get_next_key(map_rt_, prev, &next) == 0) {
+        key = next;
+        prev = &key;
+        if (bpf_map_lookup_elem(map_rt_, &key, vals.data()) != 0) continue;
+        for (int cpu = 0; cpu < ncpu; ++cpu) {
+            const tmt_rt_stat& v = vals[cpu];
+            if (!v.switches) continue;
+            RuntimeStat s;
+            s.tid = key;
+            s.cpu = (uint32_t)cpu;
+            s.comm = CommTable::instance().intern(v.comm, sizeof(v.comm));
+            s.oncpu_ns = v.oncpu_ns;
+            s.switches = v.switches;
+            s.voluntary = v.voluntary;
+            s.involuntary = v.involuntary;
+            idx[{s.tid, s.cpu}] = out.size();
+            out.push_back(s);
         }
     }
 
-    bpf_program *prog = bpf_object__find_program_by_name(obj_, "trace_sched_switch");
-    if (!prog) {
-        fprintf(stderr, "[switch] program not found\n");
-        return false;
-    }
-    link_ = bpf_program__attach_tracepoint(prog, "sched", "sched_switch");
-    if (!link_) {
-        fprintf(stderr, "[switch] attach failed: %s\n", strerror(errno));
-        return false;
-    }
-
-    bpf_program *fork_prog = bpf_object__find_program_by_name(obj_, "propagate_allow_on_fork");
-    if (!fork_prog) {
-        fprintf(stderr, "[switch] fork program not found\n");
-        return false;
-    }
-    link_fork_ = bpf_program__attach_tracepoint(fork_prog, "sched", "sched_process_fork");
-    if (!link_fork_) {
-        fprintf(stderr, "[switch] fork attach failed: %s\n", strerror(errno));
-        return false;
-    }
-
-    set_cfg_enabled_map(map_cfg_);
-
-    rb1_ = ring_buffer__new(map_rb_, sample_cb, this, nullptr);
-    if (!rb1_) {
-        fprintf(stderr, "[switch] ring_buffer__new failed\n");
-        return false;
-    }
-
-    start();
-    return true;
-}
-
-void SwitchHandler::detach() {
-    if (link_) {
-        bpf_link__destroy(link_);
-        link_ = nullptr;
-    }
-    if (link_fork_) {
-        bpf_link__destroy(link_fork_);
-        link_fork_ = nullptr;
+    // bpf_ktime_get_ns() is CLOCK_MONOTONIC
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t now = (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+
+    std::vector<tmt_cpu_run> runs(ncpu);
+    uint32_t zero = 0;
+    if (bpf_map_lookup_elem(map_run_, &zero, runs.data()) == 0) {
+        for (int cpu = 0; cpu < ncpu; ++cpu) {
+            const tmt_cpu_run& r = runs[cpu];
+            if (!r.ts || now <= r.ts) continue;
+            auto it = idx.find({r.tid, (uint32_t)cpu});
+            if (it != idx.end()) {
+                out[it->second].oncpu_ns += now - r.ts;
+            } else {
+                RuntimeStat s;
+                s.tid = r.tid;
+                s.cpu = (uint32_t)cpu;
+                s.comm = CommTable::instance().intern(r.comm, sizeof(r.comm));
+                s.oncpu_ns = now - r.ts;
+                out.push_back(s);
+            }
+        }
     }
+    return out;
 }
 
-void SwitchHandler::freeze_producer() {
-    freeze_cfg_enabled_map(map_cfg_);
-}
-
-uint64_t SwitchHandler::snapshot_total() {
-    return snapshot_evcount_percpu(map_ev_);
-}
-
-int SwitchHandler::on_sample(void *data, size_t len) {
-    if (len < sizeof(run_event_t)) return 0;
+int SwitchHandler::on_slice(void *data, size_t len) {
+    if (len < sizeof(slice_event_t)) return 0;
     read_events_.fetch_add(1, std::memory_order_relaxed);
-    const run_event_t* ev = reinterpret_cast<const run_event_t*>(data);
+    const slice_event_t* ev = reinterpret_cast<const slice_event_t*>(data);
+    uint32_t tid = ev->tid_flags & TMT_SW_TID_MASK;
 
     Event e;
-    e.event = (ev->type == 1) ? "run" : "desched";
-    e.pid   = ev->pid;
-    e.cpu   = ev->cpu;
-    e.reason = (ev->reason == 1) ? "preempt" : "sleep";
-    e.command = std::string(ev->comm);
-    e.timestamp = ev->ts;
-    e.timestamp_human = human_ts(ev->ts);
+    // a slice whose switch-in was not traced only contributes its switch-out
+    e.kind   = ev->start ? EventKind::Slice : EventKind::Desched;
+    e.pid    = tid;
+    e.tid    = tid;
+    e.cpu    = ev->hdr.cpu;
+    e.reason = (ev->tid_flags & TMT_SW_BLOCKED) ? SwitchReason::Sleep : SwitchReason::Preempt;
+    e.comm   = comm_of(tid);
+    e.timestamp = ev->end;
+    e.start  = ev->start;
+
+    store(e);
+    return 0;
+}
 
-    std::lock_guard<std::mutex> lk(mtx_);
-    events_.push_back(std::move(e));
+/* comm records precede the switch records of their tid in the ring; with
+ * --rings a tid that moved to a CPU of another ring can be read before its
+ * comm record, and has no name until it is */
+int SwitchHandler::on_comm(void *data, size_t len) {
+    if (len < sizeof(comm_event_t)) return 0;
+    read_events_.fetch_add(1, std::memory_order_relaxed);
+    const comm_event_t* ev = reinterpret_cast<const comm_event_t*>(data);
+    uint32_t id = CommTable::instance().intern(ev->comm, sizeof(ev->comm));
+    std::unique_lock<std::shared_mutex> lk(comm_mtx_, std::defer_lock);
+    if (stored_.size() > 1) lk.lock();
+    comm_cache_[ev->tid] = id;
     return 0;
 }
 
-void SwitchHandler::set_root_pids(uint32_t shell_pid, uint32_t cmd_pid) {
-    shell_pid_hint_ = shell_pid;
-    cmd_pid_hint_   = cmd_pid;
+uint32_t SwitchHandler::comm_of(uint32_t tid) const {
+    // only shared between consumer threads with --consumers
+    std::shared_lock<std::shared_mutex> lk(comm_mtx_, std::defer_lock);
+    if (stored_.size() > 1) lk.lock();
+    auto it = comm_cache_.find(tid);
+    return it != comm_cache_.end() ? it->second : 0;
+}
+
+std::vector<Event> SwitchHandler::pending_runs() const {
+    std::vector<Event> out;
+    if (map_run_ < 0) return out;
+
+    int ncpu = libbpf_num_possible_cpus();
+    if (ncpu <= 0) return out;
+
+    std::vector<tmt_cpu_run> runs(ncpu);
+    uint32_t zero = 0;
+    if (bpf_map_lookup_elem(map_run_, &zero, runs.data()) != 0) return out;
+
+    for (int cpu = 0; cpu < ncpu; ++cpu) {
+        const tmt_cpu_run& r = runs[cpu];
+        if (!r.ts) continue;
+        Event e;
+        e.kind = EventKind::Run;
+        e.pid  = r.tid;
+        e.tid  = r.tid;
+        e.cpu  = (uint32_t)cpu;
+        e.comm = CommTable::instance().intern(r.comm, sizeof(r.comm));
+        e.timestamp = r.ts;
+        out.push_back(e);
+    }
+    return out;
 }
@@ -0,0 +1,196 @@
+#include "CaptureWriter.hpp"
+#include "tmt_events.h"
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+static const char CAPTURE_MAGIC[8] = {'T', 'M', 'T', 'C', 'A', 'P', 0, 0};
+
+struct CaptureHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+};
+
+static size_t pad8(size_t n) { return (n + 7) & ~size_t(7); }
+
+CaptureWriter::CaptureWriter(size_t buf_size, size_t nbufs)
+: buf_size_(buf_size), bufs_(nbufs) {
+    for (auto& b : bufs_) {
+        b.data.reset(new char[buf_size_]);
+        free_.push_back(&b);
+    }
+}
+
+CaptureWriter::~CaptureWriter() {
+    close();
+}
+
+bool CaptureWriter::open(const std::string& path) {
+    fd_ = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd_ < 0) {
+        fprintf(stderr, "[capture] open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+
+    cur_ = take_free();
+    CaptureHeader h{};
+    memcpy(h.magic, CAPTURE_MAGIC, sizeof(h.magic));
+    h.version = TMT_WIRE_VERSION;
+    memcpy(cur_->data.get(), &h, sizeof(h));
+    cur_->used = sizeof(h);
+
+    thread_ = std::thread([this]() { writer_loop(); });
+    return true;
+}
+
+void CaptureWriter::append(const void* data, uint32_t len) {
+    size_t need = 8 + pad8(len);
+    if (cur_->used + need > buf_size_) {
+        submit(cur_);
+        cur_ = take_free();
+    }
+
+    // u32 length + 4 bytes of padding keep the record itself 8-byte aligned
+    char* p = cur_->data.get() + cur_->used;
+    uint32_t slot = (uint32_t)pad8(len);
+    memcpy(p, &len, sizeof(len));
+    memset(p + sizeof(len), 0, 4);
+    memcpy(p + 8, data, len);
+    if (slot > len) memset(p + 8 + len, 0, slot - len);
+    cur_->used += 8 + slot;
+
+    ++records_;
+    bytes_ += len;
+}
+
+void CaptureWriter::submit(Buffer* b) {
+    std::lock_guard<std::mutex> lk(mtx_);
+    full_.push_back(b);
+    cv_.notify_all();
+}
+
+CaptureWriter::Buffer* CaptureWriter::take_free() {
+    std::unique_lock<std::mutex> lk(mtx_);
+    cv_.wait(lk, [this]() { return !free_.empty(); });
+    Buffer* b = free_.front();
+    free_.pop_front();
+    b->used = 0;
+    return b;
+}
+
+void CaptureWriter::writer_loop() {
+    std::vector<Buffer*> batch;
+    std::vector<struct iovec> iov;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lk(mtx_);
+            cv_.wait(lk, [this]() { return !full_.empty() || closing_; });
+            if (full_.empty() && closing_) return;
+            while (!full_.empty() && batch.size() < IOV_MAX) {
+                batch.push_back(full_.front());
+                full_.pop_front();
+            }
+        }
+
+        iov.clear();
+        for (auto* b : batch) iov.push_back({b->data.get(), b->used});
+
+        // writev may stop short, move past what was written and retry
+        size_t first = 0;
+        while (first < iov.size() && !failed_) {
+            ssize_t n = writev(fd_, &iov[first], (int)(iov.size() - first));
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                fprintf(stderr, "[capture] write failed: %s\n", strerror(errno));
+                failed_ = true;
+                break;
+            }
+            while (n > 0 && first < iov.size()) {
+                if ((size_t)n >= iov[first].iov_len) {
+                    n -= iov[first].iov_len;
+                    ++first;
+                } else {
+                    iov[first].iov_base = (char*)iov[first].iov_base + n;
+                    iov[first].iov_len -= n;
+                    n = 0;
+                }
+            }
+        }
+
+        std::lock_guard<std::mutex> lk(mtx_);
+        for (auto* b : batch) free_.push_back(b);
+        batch.clear();
+        cv_.notify_all();
+    }
+}
+
+bool CaptureWriter::close() {
+    if (fd_ < 0) return !failed_;
+    if (cur_) {
+        submit(cur_);
+        cur_ = nullptr;
+    }
+    {
+        std::lock_guard<std::mutex> lk(mtx_);
+        closing_ = true;
+        cv_.notify_all();
+    }
+    if (thread_.joinable()) thread_.join();
+    ::close(fd_);
+    fd_ = -1;
+    return !failed_;
+}
+
+bool replay_capture(const std::string& path,
+                    int (*cb)(void* ctx, void* data, size_t len), void* ctx) {
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[capture] open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(CaptureHeader)) {
+        fprintf(stderr, "[capture] %s: not a capture file\n", path.c_str());
+        ::close(fd);
+        return false;
+    }
+    size_t size = (size_t)st.st_size;
+    void* map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        fprintf(stderr, "[capture] mmap %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    madvise(map, size, MADV_SEQUENTIAL);
+
+    const char* base = static_cast<const char*>(map);
+    CaptureHeader h;
+    memcpy(&h, base, sizeof(h));
+    if (memcmp(h.magic, CAPTURE_MAGIC, sizeof(h.magic)) != 0 || h.version != TMT_WIRE_VERSION) {
+        fprintf(stderr, "[capture] %s: bad magic or wire version %u\n", path.c_str(), h.version);
+        munmap(map, size);
+        return false;
+    }
+
+    size_t off = sizeof(h);
+    while (off + 8 <= size) {
+        uint32_t len;
+        memcpy(&len, base + off, sizeof(len));
+        if (off + 8 + len > size) {
+            fprintf(stderr, "[capture] %s: truncated record at offset %zu\n", path.c_str(), off);
+            break;
+        }
+        cb(ctx, const_cast<char*>(base + off + 8), len);
+        off += 8 + pad8(len);
+    }
+
+    munmap(map, size);
+    return true;
+}
@@ -0,0 +1,86 @@
+#include "EventMerge.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <queue>
+#include <tuple>
+
+namespace {
+
+struct Run {
+    const std::vector<Event>* part;
+    std::vector<uint32_t> idx;
+    size_t pos{0};
+
+    uint64_t ts() const { return (*part)[idx[pos]].timestamp; }
+};
+
+// records of one CPU are out of order only where a probe was preempted
+// between reading the clock and reserving, so elements move very little;
+// one that has to move further than REPAIR_WINDOW makes the insertion
+// sort quadratic, the run is stable-sorted instead
+constexpr size_t REPAIR_WINDOW = 256;
+
+void repair(Run& r) {
+    const auto& ev = *r.part;
+    for (size_t i = 1; i < r.idx.size(); ++i) {
+        uint32_t cur = r.idx[i];
+        uint64_t ts = ev[cur].timestamp;
+        size_t j = i;
+        while (j > 0 && ev[r.idx[j - 1]].timestamp > ts) {
+            if (i - j == REPAIR_WINDOW) {
+                r.idx[j] = cur;
+                std::stable_sort(r.idx.begin(), r.idx.end(), [&](uint32_t a, uint32_t b) {
+                    return ev[a].timestamp < ev[b].timestamp;
+                });
+                return;
+            }
+            r.idx[j] = r.idx[j - 1];
+            --j;
+        }
+        r.idx[j] = cur;
+    }
+}
+
+} // namespace
+
+std::vector<Event> merge_events(std::vector<std::vector<Event>>& parts) {
+    std::vector<Run> runs;
+    size_t total = 0;
+
+    for (const auto& part : parts) {
+        total += part.size();
+        std::vector<Run> by_cpu;
+        for (uint32_t i = 0; i < part.size(); ++i) {
+            uint32_t cpu = part[i].cpu;
+            if (cpu >= by_cpu.size()) by_cpu.resize(cpu + 1, Run{&part, {}});
+            by_cpu[cpu].idx.push_back(i);
+        }
+        for (auto& r : by_cpu) {
+            if (r.idx.empty()) continue;
+            repair(r);
+            runs.push_back(std::move(r));
+        }
+    }
+
+    // (timestamp, run) min-heap; ties go to the earlier run
+    using Head = std::pair<uint64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+    for (size_t r = 0; r < runs.size(); ++r)
+        heap.push({runs[r].ts(), r});
+
+    std::vector<Event> out;
+    out.reserve(total);
+    while (!heap.empty()) {
+        size_t r = heap.top().second;
+        heap.pop();
+        Run& run = runs[r];
+        out.push_back((*run.part)[run.idx[run.pos]]);
+        if (++run.pos < run.idx.size())
+            heap.push({run.ts(), r});
+    }
+
+    runs.clear();
+    for (auto& p : parts) std::vector<Event>().swap(p);
+    return out;
+}
@@ -0,0 +1,28 @@
+#include "EventPool.hpp"
+#include <algorithm>
+
+EventPool::EventPool(size_t max_bytes, size_t min_chunks)
+: capacity_(std::max(min_chunks, max_bytes / sizeof(EventChunk))) {
+    all_.reserve(capacity_);
+    free_.reserve(capacity_);
+}
+
+EventChunk* EventPool::get() {
+    EventChunk* c = nullptr;
+    if (!free_.empty()) {
+        c = free_.back();
+        free_.pop_back();
+    } else if (all_.size() < capacity_) {
+        all_.push_back(std::make_unique<EventChunk>());
+        c = all_.back().get();
+    } else {
+        return nullptr;
+    }
+    peak_ = std::max(peak_, ++in_use_);
+    return c;
+}
+
+void EventPool::put(EventChunk* c) {
+    free_.push_back(c);
+    --in_use_;
+}
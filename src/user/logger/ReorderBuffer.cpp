@@ -0,0 +1,101 @@
+#include "ReorderBuffer.hpp"
+#include <algorithm>
+#include <functional>
+#include <queue>
+
+ReorderBuffer::ReorderBuffer(EventSink& out, unsigned ncpu, uint64_t grace_ns, size_t max_bytes)
+: out_(out), pool_(max_bytes, 2 * (ncpu ? ncpu : 1)), cpus_(ncpu ? ncpu : 1), grace_ns_(grace_ns) {}
+
+bool ReorderBuffer::push(CpuQueue& c, const Event& e) {
+    size_t p = c.head + c.size;
+    if (p / EventChunk::CAP == c.chunks.size()) {
+        EventChunk* chunk = pool_.get();
+        if (!chunk) return false;
+        c.chunks.push_back(chunk);
+    }
+
+    // per-CPU order is almost always right, insert from the back
+    size_t i = c.size++;
+    while (i > 0 && c.at(i - 1).timestamp > e.timestamp) {
+        c.at(i) = c.at(i - 1);
+        --i;
+    }
+    c.at(i) = e;
+    return true;
+}
+
+void ReorderBuffer::pop_front(CpuQueue& c) {
+    --c.size;
+    if (++c.head == EventChunk::CAP) {
+        pool_.put(c.chunks.front());
+        c.chunks.pop_front();
+        c.head = 0;
+    }
+    // an idle CPU holds no chunk
+    if (!c.size) {
+        for (auto* chunk : c.chunks) pool_.put(chunk);
+        c.chunks.clear();
+        c.head = 0;
+    }
+}
+
+void ReorderBuffer::on_event(const Event& e) {
+    if (e.cpu >= cpus_.size()) cpus_.resize(e.cpu + 1);
+    CpuQueue& c = cpus_[e.cpu];
+
+    // counted once per event, however many releases it takes
+    bool forced = false;
+    for (;;) {
+        // older than something already released: can only be passed on
+        if (e.timestamp < released_ts_) {
+            ++late_;
+            forced_ += forced;
+            out_.on_event(e);
+            return;
+        }
+        if (push(c, e)) break;
+
+        // pool exhausted: give up on waiting for the oldest event
+        forced = true;
+        uint64_t oldest = UINT64_MAX;
+        for (auto& q : cpus_)
+            if (q.size) oldest = std::min(oldest, q.front().timestamp);
+        release(oldest);
+    }
+    forced_ += forced;
+    c.last_seen = std::max(c.last_seen, e.timestamp);
+    ++pending_;
+}
+
+void ReorderBuffer::advance(uint64_t round_start_ns) {
+    uint64_t seen = UINT64_MAX;
+    for (const auto& c : cpus_) seen = std::min(seen, c.last_seen);
+
+    // the grace period also covers a CPU's own preempted records
+    uint64_t watermark = std::max(seen, round_start_ns);
+    release(watermark > grace_ns_ ? watermark - grace_ns_ : 0);
+}
+
+void ReorderBuffer::flush() {
+    release(UINT64_MAX);
+}
+
+void ReorderBuffer::release(uint64_t watermark) {
+    using Head = std::pair<uint64_t, size_t>;
+    std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heads;
+    for (size_t i = 0; i < cpus_.size(); ++i)
+        if (cpus_[i].size && cpus_[i].front().timestamp <= watermark)
+            heads.push({cpus_[i].front().timestamp, i});
+
+    while (!heads.empty()) {
+        size_t i = heads.top().second;
+        heads.pop();
+        CpuQueue& q = cpus_[i];
+        released_ts_ = q.front().timestamp;
+        out_.on_event(q.front());
+        pop_front(q);
+        --pending_;
+        if (q.size && q.front().timestamp <= watermark)
+            heads.push({q.front().timestamp, i});
+    }
+}
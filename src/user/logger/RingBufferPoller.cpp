@@ -0,0 +1,129 @@
+#include "RingBufferPoller.hpp"
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+static uint64_t mono_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+RingBufferPoller::RingBufferPoller(int timeout_ms)
+: timeout_ms_(timeout_ms) {}
+
+RingBufferPoller::~RingBufferPoller() {
+    stop();
+    if (rb_) { ring_buffer__free(rb_); rb_ = nullptr; }
+}
+
+bool RingBufferPoller::add(int map_fd, ring_buffer_sample_fn cb, void *ctx) {
+    if (!rb_) {
+        rb_ = ring_buffer__new(map_fd, cb, ctx, nullptr);
+        if (!rb_) {
+            fprintf(stderr, "[consumer] ring_buffer__new failed (fd=%d)\n", map_fd);
+            return false;
+        }
+        return true;
+    }
+    int err = ring_buffer__add(rb_, map_fd, cb, ctx);
+    if (err) {
+        fprintf(stderr, "[consumer] ring_buffer__add failed (fd=%d): %d\n", map_fd, err);
+        return false;
+    }
+    return true;
+}
+
+void RingBufferPoller::start() {
+    if (!rb_ || running_.exchange(true)) return;
+
+    // the ring_buffer's own epoll set, plus an eventfd for stop()
+    epfd_ = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    struct epoll_event ev = {};
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+    bool ok = epfd_ >= 0 && wake_fd_ >= 0 &&
+              epoll_ctl(epfd_, EPOLL_CTL_ADD, ring_buffer__epoll_fd(rb_), &ev) == 0;
+    ev.data.u32 = 1;
+    if (!ok || epoll_ctl(epfd_, EPOLL_CTL_ADD, wake_fd_, &ev) != 0) {
+        fprintf(stderr, "[consumer] epoll setup failed: %s\n", strerror(errno));
+        running_ = false;
+        close_fds();
+        return;
+    }
+
+    started_ns_ = mono_ns();
+    thread_ = std::thread([this](){
+        struct epoll_event evs[2];
+        while (running_.load(std::memory_order_relaxed)) {
+            round_.fetch_add(1, std::memory_order_relaxed);
+            uint64_t round_start = mono_ns();
+            int ret = epoll_wait(epfd_, evs, 2, timeout_ms_);
+            bool ready = false;
+            for (int i = 0; i < ret; ++i) ready |= evs[i].data.u32 == 0;
+            if (ready) {
+                int n = ring_buffer__consume(rb_);
+                if (n > 0) {
+                    samples_.fetch_add((uint64_t)n, std::memory_order_relaxed);
+                    wakeups_.fetch_add(1, std::memory_order_relaxed);
+                }
+            } else if (ret == 0) {
+                // timed out: records submitted with BPF_RB_NO_WAKEUP are
+                // still sitting below the wakeup threshold
+                round_.fetch_add(1, std::memory_order_relaxed);
+                int n = ring_buffer__consume(rb_);
+                if (n > 0) {
+                    samples_.fetch_add((uint64_t)n, std::memory_order_relaxed);
+                    timer_flushes_.fetch_add(1, std::memory_order_relaxed);
+                }
+            } else if (ret < 0 && errno != EINTR) {
+                fprintf(stderr, "[consumer] epoll_wait err=%d\n", -errno);
+            }
+            if (round_hook_) round_hook_(round_start);
+        }
+    });
+}
+
+void RingBufferPoller::stop() {
+    if (!running_.exchange(false)) return;
+    uint64_t one = 1;
+    ssize_t w = write(wake_fd_, &one, sizeof(one));
+    (void)w;    // if it failed, the poll timeout still ends the wait
+    if (thread_.joinable()) thread_.join();
+    stopped_ns_ = mono_ns();
+    close_fds();
+}
+
+void RingBufferPoller::close_fds() {
+    if (epfd_ >= 0) { close(epfd_); epfd_ = -1; }
+    if (wake_fd_ >= 0) { close(wake_fd_); wake_fd_ = -1; }
+}
+
+int RingBufferPoller::consume() {
+    if (!rb_ || running_.load()) return 0;
+    round_.fetch_add(1, std::memory_order_relaxed);
+    int ret = ring_buffer__consume(rb_);
+    if (ret > 0) samples_.fetch_add((uint64_t)ret, std::memory_order_relaxed);
+    return ret;
+}
+
+uint64_t RingBufferPoller::drain() {
+    uint64_t total = 0;
+    int n;
+    while ((n = consume()) > 0) total += (uint64_t)n;
+    return total;
+}
+
+void RingBufferPoller::print_stats(const char* tag) const {
+    uint64_t end = stopped_ns_ ? stopped_ns_ : mono_ns();
+    double secs = started_ns_ ? (end - started_ns_) / 1e9 : 0.0;
+    uint64_t n = samples();
+    fprintf(stderr, "[%s] %llu samples in %.3f s (%.0f ev/s), %llu wakeups, %llu timer flushes\n",
+            tag, (unsigned long long)n, secs, secs > 0 ? n / secs : 0.0,
+            (unsigned long long)wakeups(), (unsigned long long)timer_flushes());
+}
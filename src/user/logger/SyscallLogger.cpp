@@ -1,6 +1,11 @@
 #include "SyscallLogger.hpp"
+#include "CommTable.hpp"
+#include "WallClock.hpp"
+#include "EventMerge.hpp"
+#include "tmt.skel.h"
 #include <unistd.h>
 #include <sys/wait.h>
+#include <dirent.h>
 #include <signal.h>
 #include <iostream>
 #include <algorithm>
@@ -8,51 +13,648 @@
 #include <sys/stat.h>
 #include <fstream>
 #include <sstream>
+#include <cstring>
+#include <cstdio>
+#include <ctime>
+#include <thread>
+#include <bpf/bpf.h>
+
+static uint64_t mono_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+/* Forwards the time-ordered stream to every consumer and remembers the
+ * earliest time in it, the origin of the outputs. */
+class LiveFanout : public EventSink {
+public:
+    void add(EventSink* s) { outs_.push_back(s); }
+    uint64_t origin() const { return origin_ == UINT64_MAX ? 0 : origin_; }
+
+    void on_begin(uint32_t root_pid, uint64_t start_ns) override {
+        for (auto* s : outs_) s->on_begin(root_pid, start_ns);
+    }
+    void on_event(const Event& e) override {
+        // a slice starts before the event carrying it
+        uint64_t t = e.kind == EventKind::Slice ? std::min(e.start, e.timestamp) : e.timestamp;
+        if (t < origin_) origin_ = t;
+        for (auto* s : outs_) s->on_event(e);
+    }
+    void on_end() override {
+        for (auto* s : outs_) s->on_end();
+    }
+
+private:
+    std::vector<EventSink*> outs_;
+    uint64_t origin_{UINT64_MAX};
+};
+
+/* One consumer thread and the rings it drains. */
+class ConsumerLane {
+public:
+    ConsumerLane(SyscallLogger* owner, uint32_t idx, int timeout_ms)
+    : owner(owner), idx(idx), poller(timeout_ms) {}
+
+    SyscallLogger* owner;
+    uint32_t idx;
+    RingBufferPoller poller;
+    // live, several lanes: events decoded in the current round
+    EventChunkList batch;
+    // start of the last round handed to the reorder buffer (reorder_mtx_)
+    uint64_t round_start{0};
+};
+
+// lane of the thread running the ring buffer callbacks
+static thread_local ConsumerLane* t_lane = nullptr;
+
+namespace {
+
+/* handler sink with several lanes: collect in the calling lane's batch */
+class LaneRouter : public EventSink {
+public:
+    void on_event(const Event& e) override { t_lane->batch.push(e); }
+};
+
+} // namespace
 
 SyscallLogger::SyscallLogger(int timeout_ms)
 : timeout_ms_(timeout_ms)
 {
-    handlers_.emplace_back(std::make_unique<ExecveHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<ForkHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<ExitHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<ExitGroupHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<SwitchHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<CloneHandler>(timeout_ms_));
-    handlers_.emplace_back(std::make_unique<Clone3Handler>(timeout_ms_));
+    fanout_ = std::make_unique<LiveFanout>();
+    handlers_.emplace_back(std::make_unique<ExecveHandler>());
+    handlers_.emplace_back(std::make_unique<ForkHandler>());
+    handlers_.emplace_back(std::make_unique<ExitHandler>());
+    handlers_.emplace_back(std::make_unique<ExitGroupHandler>());
+    handlers_.emplace_back(std::make_unique<SwitchHandler>());
+    handlers_.emplace_back(std::make_unique<CloneHandler>());
+    handlers_.emplace_back(std::make_unique<Clone3Handler>());
+}
+
+SyscallLogger::~SyscallLogger() {
+    for (auto& l : lanes_) l->poller.stop();
+    handlers_.clear();
+    lanes_.clear();
+    if (exit_link_) bpf_link__destroy(exit_link_);
+    if (skel_) tmt_bpf__destroy(skel_);
+    for (int fd : ring_fds_) close(fd);
+}
+
+bool SyscallLogger::load_bpf() {
+    libbpf_set_strict_mode(LIBBPF_STRICT_ALL);
+
+    skel_ = tmt_bpf__open();
+    if (!skel_) {
+        fprintf(stderr, "[tmt] skeleton open failed\n");
+        return false;
+    }
+    if (rings_ && !create_rings()) return false;
+    if (summary_size_ && bpf_map__set_max_entries(skel_->maps.rt_stats, summary_size_)) {
+        fprintf(stderr, "[tmt] cannot size the runtime table to %u\n", summary_size_);
+        return false;
+    }
+    if (filter_size_ && bpf_map__set_max_entries(skel_->maps.allow_pids, filter_size_)) {
+        fprintf(stderr, "[filter] cannot size the pid filter to %u\n", filter_size_);
+        return false;
+    }
+    int err = tmt_bpf__load(skel_);
+    if (err) {
+        fprintf(stderr, "[tmt] load failed: %s (err=%d)\n", strerror(-err), err);
+        return false;
+    }
+
+    map_cfg_    = bpf_map__fd(skel_->maps.cfg);
+    map_ev_     = bpf_map__fd(skel_->maps.ev_count);
+    map_events_ = bpf_map__fd(skel_->maps.events);
+    map_drops_  = bpf_map__fd(skel_->maps.drops);
+    if (rings_ && !insert_rings()) return false;
+
+    int ncpu = libbpf_num_possible_cpus();
+    last_seq_.assign(ncpu > 0 ? ncpu : 1, 0);
+    seq_gaps_.assign(last_seq_.size(), 0);
+    return true;
+}
+
+/* The rings are created before the load: the first one stands in for the
+ * inner map template, so all of them get the same size. The shared ring is
+ * shrunk to a page, it is only written if a lookup fails. */
+bool SyscallLogger::create_rings() {
+    // the kernel wants a page-aligned power of two: the largest one that
+    // keeps the rings within 16 MiB, but at least a page
+    uint32_t page = (uint32_t)getpagesize();
+    uint32_t bytes = page;
+    while (bytes <= (16u << 20) / rings_ / 2) bytes <<= 1;
+
+    for (uint32_t i = 0; i < rings_; ++i) {
+        int fd = bpf_map_create(BPF_MAP_TYPE_RINGBUF, "tmt_ring", 0, 0, bytes, nullptr);
+        if (fd < 0) {
+            fprintf(stderr, "[tmt] creating ring buffer %u failed: %s\n", i, strerror(errno));
+            return false;
+        }
+        ring_fds_.push_back(fd);
+    }
+    if (bpf_map__set_max_entries(skel_->maps.cpu_rings, rings_) ||
+        bpf_map__set_inner_map_fd(skel_->maps.cpu_rings, ring_fds_.front()) ||
+        bpf_map__set_max_entries(skel_->maps.events, page)) {
+        fprintf(stderr, "[tmt] failed to size the per-CPU ring buffers\n");
+        return false;
+    }
+    return true;
+}
+
+bool SyscallLogger::insert_rings() {
+    int outer = bpf_map__fd(skel_->maps.cpu_rings);
+    for (uint32_t i = 0; i < rings_; ++i) {
+        if (bpf_map_update_elem(outer, &i, &ring_fds_[i], BPF_ANY) != 0) {
+            fprintf(stderr, "[tmt] failed to insert ring buffer %u\n", i);
+            return false;
+        }
+    }
+    uint32_t key = TMT_CFG_RINGS;
+    if (bpf_map_update_elem(map_cfg_, &key, &rings_, BPF_ANY) != 0) {
+        fprintf(stderr, "[tmt] failed to enable the per-CPU ring buffers\n");
+        return false;
+    }
+    return true;
+}
+
+/* lane i drains rings i, i + n, ...; lane 0 also the shared ring */
+void SyscallLogger::make_lanes() {
+    uint32_t n = rings_ ? std::min(consumers_, rings_) : 1;
+    for (uint32_t i = 0; i < n; ++i)
+        lanes_.push_back(std::make_unique<ConsumerLane>(this, i, timeout_ms_));
+    for (auto& h : handlers_) h->set_producers(n);
+}
+
+void SyscallLogger::flush_lane(ConsumerLane& lane, uint64_t round_start) {
+    std::lock_guard<std::mutex> lk(reorder_mtx_);
+    lane.batch.for_each([&](const Event& e) { reorder_->on_event(e); });
+    lane.batch.clear();
+    if (!round_start) return;
+    // every lane has drained its rings up to the oldest of their rounds
+    lane.round_start = round_start;
+    uint64_t oldest = UINT64_MAX;
+    for (const auto& l : lanes_) oldest = std::min(oldest, l->round_start);
+    reorder_->advance(oldest);
+}
+
+void SyscallLogger::set_wakeup_threshold() {
+    uint32_t key = TMT_CFG_WAKEUP_BYTES;
+    if (bpf_map_update_elem(map_cfg_, &key, &wakeup_bytes_, BPF_ANY) != 0)
+        fprintf(stderr, "[tmt] failed to set wakeup threshold\n");
+}
+
+void SyscallLogger::set_producers_enabled(bool on) {
+    uint32_t key = TMT_CFG_ENABLED, val = on ? 1 : 0;
+    bpf_map_update_elem(map_cfg_, &key, &val, BPF_ANY);
+}
+
+/* [kind][cpu] values of a per-CPU array keyed by record kind */
+std::vector<std::vector<uint64_t>> SyscallLogger::read_kind_counts(int map_fd) const {
+    int n = libbpf_num_possible_cpus();
+    std::vector<std::vector<uint64_t>> out(TMT_EV_MAX, std::vector<uint64_t>(n > 0 ? n : 1, 0));
+    for (uint32_t kind = 0; kind < TMT_EV_MAX; ++kind)
+        bpf_map_lookup_elem(map_fd, &kind, out[kind].data());
+    return out;
+}
+
+std::vector<uint64_t> SyscallLogger::snapshot_ev_counts() const {
+    std::vector<uint64_t> totals(TMT_EV_MAX, 0);
+    auto per_cpu = read_kind_counts(map_ev_);
+    for (uint32_t kind = 0; kind < TMT_EV_MAX; ++kind)
+        for (auto v : per_cpu[kind]) totals[kind] += v;
+    return totals;
+}
+
+/* sequence numbers start at 1 on each CPU, any jump is a lost record */
+void SyscallLogger::track_seq(uint16_t cpu, uint32_t seq) {
+    if (cpu >= last_seq_.size()) return;
+    uint32_t gap = seq - last_seq_[cpu] - 1;
+    if (gap && gap < 0x80000000u) seq_gaps_[cpu] += gap;
+    last_seq_[cpu] = seq;
+}
+
+void SyscallLogger::report_losses(const std::vector<uint64_t>& totals) {
+    auto drops = read_kind_counts(map_drops_);
+    lost_events_ = 0;
+
+    for (size_t i = 0; i < handlers_.size(); ++i) {
+        auto& h = handlers_[i];
+        if (by_kind_[h->kinds().front()] != h.get()) continue;
+        uint64_t dropped = 0;
+        for (uint16_t kind : h->kinds())
+            for (auto v : drops[kind]) dropped += v;
+        uint64_t read = h->read_total();
+        uint64_t unread = totals[i] > read ? totals[i] - read : 0;
+        if (dropped || unread) {
+            fprintf(stderr, "[WARN] %s: %llu events dropped (ring buffer full), %llu not read\n",
+                    h->name().c_str(), (unsigned long long)dropped, (unsigned long long)unread);
+        }
+        lost_events_ += dropped + unread;
+    }
+
+    for (size_t cpu = 0; cpu < last_seq_.size(); ++cpu) {
+        uint64_t dropped = 0;
+        for (uint32_t kind = 0; kind < TMT_EV_MAX; ++kind) dropped += drops[kind][cpu];
+        if (dropped || seq_gaps_[cpu]) {
+            fprintf(stderr, "[WARN] cpu %zu: %llu events dropped, %llu sequence gaps\n",
+                    cpu, (unsigned long long)dropped, (unsigned long long)seq_gaps_[cpu]);
+        }
+    }
+
+    if (switch_mode_ == TMT_SWITCH_SUMMARY) {
+        // slices of tids that found rt_stats full are missing from the summary
+        std::vector<uint64_t> vals(last_seq_.size(), 0);
+        uint32_t key = 0;
+        uint64_t rt_full = 0;
+        if (bpf_map_lookup_elem(bpf_map__fd(skel_->maps.rt_drops), &key, vals.data()) == 0)
+            for (auto v : vals) rt_full += v;
+        if (rt_full) {
+            fprintf(stderr, "[WARN] summary: %llu slices not accounted, runtime table full "
+                            "(%u threads), raise --summary-size\n",
+                    (unsigned long long)rt_full, bpf_map__max_entries(skel_->maps.rt_stats));
+            lost_events_ += rt_full;
+        }
+    }
+
+    if (lost_events_)
+        fprintf(stderr, "[WARN] %llu events lost: output is INCOMPLETE\n",
+                (unsigned long long)lost_events_);
+    else if (verbose_)
+        fprintf(stderr, "[INFO] no events lost\n");
+}
+
+int SyscallLogger::dispatch_cb(void *ctx, void *data, size_t len) {
+    auto* lane = static_cast<ConsumerLane*>(ctx);
+    auto* self = lane->owner;
+    t_lane = lane;
+    BaseHandler::set_producer(lane->idx);
+    if (len < sizeof(tmt_event_hdr)) return 0;
+    const auto* hdr = static_cast<const tmt_event_hdr*>(data);
+    if (hdr->version != TMT_WIRE_VERSION) {
+        if (!self->bad_version_.fetch_add(1, std::memory_order_relaxed))
+            fprintf(stderr, "[tmt] dropping records with wire version %u (expected %u)\n",
+                    hdr->version, TMT_WIRE_VERSION);
+        return 0;
+    }
+    self->track_seq(hdr->cpu, hdr->seq);
+    uint8_t kind = hdr->kind;
+    if (kind >= TMT_EV_MAX || !self->by_kind_[kind]) return 0;
+    BaseHandler* h = self->by_kind_[kind];
+    // rounds of different lanes must not look alike
+    h->note_round(lane->poller.round() * self->lanes_.size() + lane->idx);
+    if (self->capture_) {
+        std::unique_lock<std::mutex> lk(self->capture_mtx_, std::defer_lock);
+        if (self->lanes_.size() > 1) lk.lock();
+        self->capture_->append(data, len);
+        h->count_raw();
+        return 0;
+    }
+    return h->on_sample(data, len);
+}
+
+/* version and sequence were checked when the record was captured */
+int SyscallLogger::replay_cb(void *ctx, void *data, size_t len) {
+    auto* self = static_cast<SyscallLogger*>(ctx);
+    if (len < sizeof(tmt_event_hdr)) return 0;
+    uint8_t kind = static_cast<const tmt_event_hdr*>(data)->kind;
+    if (kind >= TMT_EV_MAX || !self->by_kind_[kind]) return 0;
+    return self->by_kind_[kind]->on_sample(data, len);
+}
+
+void SyscallLogger::replay_capture_file() {
+    uint64_t records = capture_->records();
+    uint64_t bytes = capture_->bytes();
+    bool ok = capture_->close();
+    capture_.reset();
+    if (!ok) {
+        fprintf(stderr, "[capture] %s is incomplete, decoding what was written\n",
+                capture_path_.c_str());
+    }
+
+    // the consumers are stopped, decode into the first slot
+    BaseHandler::set_producer(0);
+    for (auto& h : handlers_) h->reset_read_total();
+    auto t0 = std::chrono::steady_clock::now();
+    replay_capture(capture_path_, replay_cb, this);
+    if (verbose_) {
+        double ms = std::chrono::duration<double, std::milli>(
+            std::chrono::steady_clock::now() - t0).count();
+        fprintf(stderr, "[capture] %llu records (%llu bytes) in %s, decoded in %.1f ms\n",
+                (unsigned long long)records, (unsigned long long)bytes,
+                capture_path_.c_str(), ms);
+    }
+}
+
+namespace {
+
+/* --print-raw: one line per event, printed live in time order */
+class RawPrinter : public EventSink {
+public:
+    explicit RawPrinter(bool wall_clock) : wall_clock_(wall_clock) {}
+
+    void on_event(const Event& e) override {
+        if (!origin_) origin_ = e.timestamp;
+        if (wall_clock_) std::cout << WallClock::instance().format(e.timestamp);
+        else             std::cout << (e.timestamp >= origin_ ? e.timestamp - origin_ : 0);
+        std::cout << " " << event_kind_name(e.kind)
+                  << " pid=" << e.pid
+                  << " child=" << e.child_pid;
+        if (e.kind == EventKind::Slice)
+            std::cout << " start=" << (e.start >= origin_ ? e.start - origin_ : 0);
+        std::cout << " comm=" << comm_name(e.comm) << "\n";
+    }
+
+private:
+    bool wall_clock_;
+    uint64_t origin_{0};
+};
+
+} // namespace
+
+void SyscallLogger::add_sink(EventSink* sink) {
+    fanout_->add(sink);
+    has_sinks_ = true;
+}
+
+void SyscallLogger::start_live_output(bool print_raw) {
+    if (print_raw) {
+        raw_printer_ = std::make_unique<RawPrinter>(wall_clock_);
+        fanout_->add(raw_printer_.get());
+    }
+    int ncpu = libbpf_num_possible_cpus();
+    reorder_ = std::make_unique<ReorderBuffer>(*fanout_, ncpu > 0 ? ncpu : 1,
+                                               10 * 1000 * 1000, reorder_bytes_);
+    if (lanes_.size() == 1) {
+        for (auto& h : handlers_) {
+            h->set_sink(reorder_.get());
+            h->set_keep_events(false);
+        }
+        lanes_[0]->poller.set_round_hook([this](uint64_t start) { reorder_->advance(start); });
+        return;
+    }
+
+    lane_router_ = std::make_unique<LaneRouter>();
+    for (auto& h : handlers_) {
+        h->set_sink(lane_router_.get());
+        h->set_keep_events(false);
+    }
+    for (auto& l : lanes_) {
+        ConsumerLane* lane = l.get();
+        lane->poller.set_round_hook([this, lane](uint64_t start) { flush_lane(*lane, start); });
+    }
+}
+
+static void allow_tid(int map_allow, uint32_t tid) {
+    uint8_t one = 1;
+    bpf_map_update_elem(map_allow, &tid, &one, BPF_ANY);
+}
+
+static void allow_threads_of(int map_allow, uint32_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%u/task", pid);
+    DIR* d = opendir(path);
+    if (!d) {
+        allow_tid(map_allow, pid);
+        return;
+    }
+    struct dirent* de;
+    while ((de = readdir(d)) != nullptr) {
+        if (de->d_name[0] == '.') continue;
+        unsigned long tid = strtoul(de->d_name, nullptr, 10);
+        if (tid > 0 && tid <= 0xfffffffful)
+            allow_tid(map_allow, (uint32_t)tid);
+    }
+    closedir(d);
+}
+
+/* Every probe only emits for the tids in allow_pids: the command's and,
+ * added by handle_sched_fork as they are created, its descendants'.
+ * mark_exit flags exiting tids, sched_switch drops them when they are
+ * switched out for the last time. */
+bool SyscallLogger::install_filter() {
+    if (!root_pid_) return true;
+
+    bpf_program* prog = bpf_object__find_program_by_name(skel_->obj, "mark_exit");
+    exit_link_ = prog ? bpf_program__attach_tracepoint(prog, "sched", "sched_process_exit")
+                      : nullptr;
+    if (!exit_link_)
+        fprintf(stderr, "[filter] attach sched/sched_process_exit failed, "
+                        "exited tids stay in the filter\n");
+
+    allow_threads_of(bpf_map__fd(skel_->maps.allow_pids), root_pid_);
+    uint32_t key = TMT_CFG_USE_FILTER, on = 1;
+    if (bpf_map_update_elem(map_cfg_, &key, &on, BPF_ANY) != 0) {
+        fprintf(stderr, "[filter] failed to enable the pid filter\n");
+        return false;
+    }
+    if (!by_kind_[TMT_EV_FORK])
+        fprintf(stderr, "[filter] fork probe not attached, children of %u are not traced\n",
+                root_pid_);
+    else
+        fprintf(stderr, "[filter] tracing tgid=%u and its descendants\n", root_pid_);
+    return true;
+}
+
+void SyscallLogger::report_filter() {
+    if (!root_pid_) return;
+    int fd = bpf_map__fd(skel_->maps.filter_stats);
+    int ncpu = libbpf_num_possible_cpus();
+    std::vector<uint64_t> vals(ncpu > 0 ? ncpu : 1);
+    uint64_t stat[TMT_FILTER_MAX] = {};
+    for (uint32_t key = 0; key < TMT_FILTER_MAX; ++key)
+        if (bpf_map_lookup_elem(fd, &key, vals.data()) == 0)
+            for (auto v : vals) stat[key] += v;
+
+    if (stat[TMT_FILTER_FULL]) {
+        // their events never left the kernel
+        fprintf(stderr, "[WARN] pid filter full (%u entries): %llu new tasks not traced, "
+                        "raise --filter-size\n",
+                bpf_map__max_entries(skel_->maps.allow_pids),
+                (unsigned long long)stat[TMT_FILTER_FULL]);
+        lost_events_ += stat[TMT_FILTER_FULL];
+    }
+    if (verbose_) {
+        fprintf(stderr, "[filter] %llu tasks added, %llu exited and removed\n",
+                (unsigned long long)stat[TMT_FILTER_ADDED],
+                (unsigned long long)stat[TMT_FILTER_REMOVED]);
+    }
+}
+
+static double ms_since(std::chrono::steady_clock::time_point t) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - t).count();
 }
 
 bool SyscallLogger::install_all() {
+    auto t0 = std::chrono::steady_clock::now();
+    if (!load_bpf()) return false;
+    load_ms_ = ms_since(t0);
+
+    t0 = std::chrono::steady_clock::now();
     bool ok = false;
     for (auto& h : handlers_) {
-        if (h->install()) ok = true;
-        else std::cerr << "Install failed for handler: " << h->name() << "\n";
+        if (!h->install(skel_->obj)) {
+            std::cerr << "Install failed for handler: " << h->name() << "\n";
+            h->detach();
+            continue;
+        }
+        for (uint16_t kind : h->kinds()) by_kind_[kind] = h.get();
+        ok = true;
+    }
+    if (!ok || !install_filter()) return false;
+
+    if (!capture_path_.empty()) {
+        capture_ = std::make_unique<CaptureWriter>();
+        if (!capture_->open(capture_path_)) return false;
+    }
+
+    if (!lanes_[0]->poller.add(map_events_, dispatch_cb, lanes_[0].get())) return false;
+    for (size_t i = 0; i < ring_fds_.size(); ++i) {
+        auto& lane = lanes_[i % lanes_.size()];
+        if (!lane->poller.add(ring_fds_[i], dispatch_cb, lane.get())) return false;
     }
-    return ok;
+    set_wakeup_threshold();
+    set_producers_enabled(true);
+    for (auto& l : lanes_) l->poller.start();
+    attach_ms_ = ms_since(t0);
+    return true;
+}
+
+/* Producers are off, but a probe that read the flag just before may still
+ * be between reserve and submit. Probes never sleep, so the counts settle
+ * within microseconds: take them once two reads agree. */
+std::vector<uint64_t> SyscallLogger::freeze_counts() const {
+    auto counts = snapshot_ev_counts();
+    for (int i = 0; i < 100; ++i) {
+        usleep(20);
+        auto again = snapshot_ev_counts();
+        if (again == counts) break;
+        counts = std::move(again);
+    }
+    return counts;
+}
+
+/* Each lane drains its rings on its own thread until a pass finds them
+ * empty. With the producers frozen an empty pass means everything
+ * submitted was read, unless a record is still being written; only then
+ * are the rings drained again, for at most DRAIN_WAIT. */
+uint64_t SyscallLogger::drain_until(const std::vector<uint64_t>& totals) {
+    auto reached = [&]() {
+        for (size_t i = 0; i < handlers_.size(); ++i)
+            if (handlers_[i]->read_total() < totals[i]) return false;
+        return true;
+    };
+
+    std::atomic<uint64_t> read{0};
+    auto drain_lane = [&](ConsumerLane& l) {
+        read += l.poller.drain();
+        if (lane_router_) flush_lane(l, 0);
+    };
+
+    const auto DRAIN_WAIT = std::chrono::milliseconds(20);
+    auto deadline = std::chrono::steady_clock::now() + DRAIN_WAIT;
+    for (;;) {
+        if (lanes_.size() == 1) {
+            drain_lane(*lanes_[0]);
+        } else {
+            std::vector<std::thread> threads;
+            for (auto& l : lanes_) threads.emplace_back(drain_lane, std::ref(*l));
+            for (auto& t : threads) t.join();
+        }
+        if (reached() || std::chrono::steady_clock::now() >= deadline) break;
+        usleep(100);
+    }
+    return read;
 }
 
 void SyscallLogger::coordinated_stop() {
-    for (auto& h : handlers_) h->freeze_producer();
+    auto t0 = std::chrono::steady_clock::now();
+    set_producers_enabled(false);
 
+    auto counts = freeze_counts();
     std::vector<uint64_t> totals;
     totals.reserve(handlers_.size());
-    for (auto& h : handlers_) totals.push_back(h->snapshot_total());
+    for (auto& h : handlers_) {
+        uint64_t t = 0;
+        if (by_kind_[h->kinds().front()] == h.get())
+            for (uint16_t kind : h->kinds()) t += counts[kind];
+        totals.push_back(t);
+    }
 
-    for (size_t i = 0; i < handlers_.size(); ++i)
-        handlers_[i]->drain_until(totals[i]);
+    for (auto& l : lanes_) l->poller.stop();
+    uint64_t drained = drain_until(totals);
+    if (verbose_) {
+        fprintf(stderr, "[INFO] shutdown: %llu records drained, %.3f ms from stop to drained\n",
+                (unsigned long long)drained, ms_since(t0));
+    }
+    report_losses(totals);
+    report_filter();
+    if (capture_) replay_capture_file();
 
-    for (auto& h : handlers_) { h->detach(); h->stop(); }
+    summary_stats_.clear();
+    std::vector<Event> pending;
+    for (auto& h : handlers_) {
+        auto* sh = dynamic_cast<SwitchHandler*>(h.get());
+        if (!sh) continue;
+        if (sh->mode() == TMT_SWITCH_SUMMARY) summary_stats_ = sh->read_summary();
+        if (sh->mode() == TMT_SWITCH_SLICES)  pending = sh->pending_runs();
+    }
+
+    if (live_) {
+        reorder_->flush();
+        // switch-ins of tasks still running: the watermark is past them, and
+        // nothing else is left, so they go out last, in order among themselves
+        std::stable_sort(pending.begin(), pending.end(), [](const Event& a, const Event& b) {
+            return a.timestamp < b.timestamp;
+        });
+        for (const auto& e : pending) fanout_->on_event(e);
+        std::cout.flush();
+        if (reorder_->late())
+            fprintf(stderr, "[WARN] %llu events delivered out of order\n",
+                    (unsigned long long)reorder_->late());
+        if (verbose_) {
+            const auto& pool = reorder_->pool();
+            fprintf(stderr, "[INFO] reorder pool: peak %zu of %zu chunks (%zu KiB), "
+                            "full for %llu events\n",
+                    pool.peak(), pool.capacity(), pool.bytes() / 1024,
+                    (unsigned long long)reorder_->forced());
+        }
+    }
+    if (verbose_) {
+        if (lanes_.size() == 1) {
+            lanes_[0]->poller.print_stats();
+        } else {
+            for (auto& l : lanes_) {
+                std::string tag = "consumer " + std::to_string(l->idx);
+                l->poller.print_stats(tag.c_str());
+            }
+        }
+        for (auto& h : handlers_)
+            if (h->read_total()) h->print_wakeup_stats();
+    }
+
+    for (auto& h : handlers_) h->detach();
+    if (exit_link_) {
+        bpf_link__destroy(exit_link_);
+        exit_link_ = nullptr;
+    }
 
     events_.clear();
-    for (auto& h : handlers_) {
-        auto v = h->collect();
-        events_.insert(events_.end(), v.begin(), v.end());
+    events_.shrink_to_fit();
+    if (!live_) {
+        std::vector<std::vector<Event>> parts;
+        for (auto& h : handlers_) parts.push_back(h->take_events());
+        parts.push_back(std::move(pending));
+        events_ = merge_events(parts);
+        // not streamed during the run: hand the sinks the merged events now
+        for (const auto& e : events_) fanout_->on_event(e);
     }
-    std::sort(events_.begin(), events_.end(),
-              [](const Event& a, const Event& b) { return a.timestamp < b.timestamp; });
+    fanout_->on_end();
+    if (!streaming_) origin_ns_ = fanout_->origin();
 
-    if (!events_.empty()) {
-        uint64_t t0 = events_.front().timestamp;
-        for (auto& e : events_) e.timestamp -= t0;
+    if (has_sinks_) {
+        events_.clear();
+        events_.shrink_to_fit();
     }
 }
 
@@ -105,12 +707,17 @@ void SyscallLogger::run_command(const std::string& cmd, bool print_raw) {
     // pass cmd_pid to the Event Processor
     root_pid_ = static_cast<uint32_t>(cmd_pid);
 
-    // pass the cmd_pid to the SwitchHandler
-    for (auto& h : handlers_) {
-        if (auto* sh = dynamic_cast<SwitchHandler*>(h.get())) {
-            sh->set_root_pids(/*shell_pid=*/0, static_cast<uint32_t>(cmd_pid));
-        }
-    }
+    for (auto& h : handlers_)
+        if (auto* sh = dynamic_cast<SwitchHandler*>(h.get())) sh->set_mode(switch_mode_);
+
+    make_lanes();
+    // captured records are only decoded after the stop
+    live_ = capture_path_.empty() && (print_raw || has_sinks_);
+    if (live_) start_live_output(print_raw);
+    // producers are enabled after this, every event is later
+    uint64_t start_ns = mono_ns();
+    if (streaming_) origin_ns_ = start_ns;
+    fanout_->on_begin(root_pid_, start_ns);
 
     if (!install_all()) {
         std::cerr << "No handler installed successfully; aborting.\n";
@@ -121,19 +728,16 @@ void SyscallLogger::run_command(const std::string& cmd, bool print_raw) {
     // resume the child once handlers are installed
     kill(cmd_pid, SIGCONT);
 
+    if (verbose_) {
+        fprintf(stderr, "[INFO] startup: %.3f ms from main to target release "
+                        "(bpf load %.3f ms, attach %.3f ms)\n",
+                ms_since(t_start_), load_ms_, attach_ms_);
+    }
+
     // wait the cmd end
     if (waitpid(cmd_pid, nullptr, 0) < 0) {
         std::cerr << "waitpid failed: " << strerror(errno) << "\n";
     }
 
     coordinated_stop();
-
-    if (print_raw) {
-        for (auto& e : events_) {
-            std::cout << e.timestamp << " " << e.event
-                      << " pid=" << e.pid
-                      << " child=" << e.child_pid
-                      << " comm=" << e.command << "\n";
-        }
-    }
 }
@@ -1,6 +1,7 @@
 #include "EventProcessor.hpp"
+#include "ProcTree.hpp"
+#include "CommTable.hpp"
 #include <iostream>
-#include <fstream>
 #include <algorithm>
 #include <set>
 #include <map>
@@ -14,187 +15,113 @@
 #endif
 
 
-struct Node {
-    uint32_t pid;
-    std::string command;
-    bool alive{false};
-    std::vector<Node> children;
+EventProcessor::~EventProcessor() = default;
 
-    Node(uint32_t pid_, const std::string& cmd_, bool alive_ = false)
-        : pid(pid_), command(cmd_), alive(alive_) {}
+EventProcessor::EventProcessor(uint32_t root_pid)
+: root_pid_hint_(root_pid) {}
 
-    int size() const {
-        int total = 1;
-        for (const auto& c : children)
-            total += c.size();
-        return total;
-    }
+bool EventProcessor::stream_to(const std::string& filename) {
+    if (!stream_.open(filename)) return false;
+    stream_path_ = filename;
+    stream_.put("time,alive\n");
+    return true;
+}
 
-    int compute_alive() const {
-        if (!alive) return 0;
-        int total = 1;
-        for (const auto& c : children)
-            total += c.compute_alive();
-        return total;
-    }
+void EventProcessor::on_begin(uint32_t root_pid, uint64_t start_ns) {
+    if (!tree_ && root_pid) root_pid_hint_ = root_pid;
+    stream_origin_ = start_ns;
+}
 
-    void set_alive(uint32_t target_pid) {
-        if (pid == target_pid) {
-            alive = true;
-            return;
-        }
-        for (auto& c : children)
-            c.set_alive(target_pid);
-    }
+void EventProcessor::add_point(uint64_t time, int alive) {
+    last_ = { time, alive };
+    if (stream_.is_open()) {
+        stream_.put(time >= stream_origin_ ? time - stream_origin_ : 0).put(',').put(alive);
+        stream_.end_row();
+    } else
+        time_intervals_.push_back(last_);
+}
 
-    void kill_all() {
-        alive = false;
-        for (auto& c : children)
-            c.kill_all();
-    }
+void EventProcessor::on_event(const Event& e) {
+    ++events_;
 
-    void set_dead(uint32_t target_pid) {
-        if (pid == target_pid) {
-            kill_all();
-        } else {
-            for (auto& c : children)
-                c.set_dead(target_pid);
-        }
+    if (!tree_) {
+        uint32_t root_pid = root_pid_hint_ ? root_pid_hint_ : e.pid;
+        tree_ = std::make_unique<ProcTree>();
+        tree_->add(root_pid, CommTable::instance().intern("[unknown]"), ProcTree::NONE);
+        tree_->set_alive(root_pid);
     }
-
-    bool add_child(const Event& e) {
-        if (e.event == "fork" || e.event == "clone" || e.event == "clone3") {
-            if (e.pid == pid) {
-                children.emplace_back(e.child_pid, e.command);
-                return true;
-            } else {
-                for (auto& c : children)
-                    if (c.add_child(e))
-                        return true;
-            }
-        }
-        return false;
+    // the root is named after its first event
+    if (!root_comm_known_ && e.pid == tree_->nodes[0].pid) {
+        tree_->nodes[0].comm = e.comm;
+        root_comm_known_ = true;
     }
-};
-
-
-EventProcessor::~EventProcessor() = default;
 
-EventProcessor::EventProcessor(const std::vector<Event>& evs, uint32_t root_pid)
-: events_(evs), root_pid_hint_(root_pid)
-{
-    if (events_.empty())
-        return;
+    if (e.timestamp > max_ts_)
+        max_ts_ = e.timestamp;
 
-    root_pid = root_pid_hint_;
-    std::string root_comm = "[unknown]";
-
-    if (root_pid == 0) {
-        root_pid  = events_.front().pid;
-        root_comm = events_.front().command;
-    } else {
-        for (const auto& e : events_) {
-            if (e.pid == root_pid) {
-                root_comm = e.command;
-                break;
-            }
-        }
+    // only sched_process_fork builds the tree: a clone/clone3 exit names
+    // the same child again
+    if (e.kind == EventKind::Fork) {
+        tree_->add_child(e);
+        tree_->set_alive(e.child_pid);
+    }
+    else if (e.kind == EventKind::Exit) {
+        tree_->set_dead(e.pid);
+    }
+    else if (e.kind == EventKind::ExitGroup) {
+        tree_->set_dead(e.parent_pid);
     }
 
-    root_ = std::make_unique<Node>(root_pid, root_comm, true);
+    int alive = tree_->alive_count;
+    if (last_.alive != alive) {
+        DBG_PRINT(
+            "[DBG] ts=" << e.timestamp
+            << " event=" << event_kind_name(e.kind)
+            << " pid=" << e.pid
+            << " parent_pid=" << e.parent_pid
+            << " alive=" << last_.alive << " -> " << alive
+        );
+        add_point(e.timestamp, alive);
+    }
 }
 
+void EventProcessor::on_end() {
+    if (!tree_) return;
 
-void EventProcessor::build_tree(bool print_tree) {
-    std::cerr << "[WARN] Building process tree...\n";
-    if (!root_) return;
-
-    for (const auto& e : events_)
-        root_->add_child(e);
+    if (last_.alive >= 0 && last_.time < max_ts_)
+        add_point(max_ts_, last_.alive);
 
-    std::cerr << "[INFO] Tree built successfully.\n";
-
-    if (print_tree) {
-        print_tree_rec(*root_, 0);
+    std::cerr << "[INFO] Process tree: " << tree_->nodes.size() << " nodes";
+    if (stream_.is_open()) {
+        stream_.close();
+        std::cerr << ", alive series streamed to " << stream_path_ << "\n";
+    } else {
+        std::cerr << ", " << time_intervals_.size() << " time intervals.\n";
     }
 }
 
-void EventProcessor::print_tree_rec(const Node& n, int depth) const {
+void EventProcessor::print_tree() const {
+    if (tree_) print_tree_rec(0, 0);
+}
+
+void EventProcessor::print_tree_rec(uint32_t idx, int depth) const {
+    const auto& n = tree_->nodes[idx];
     for (int i = 0; i < depth; ++i) std::cerr << "  ";
-    std::cerr << n.command << " (" << n.pid << ")";
+    std::cerr << comm_name(n.comm) << " (" << n.pid << ")";
     if (n.alive) std::cerr << " [ALIVE]";
     std::cerr << "\n";
-    for (const auto& c : n.children)
+    for (uint32_t c : n.children)
         print_tree_rec(c, depth + 1);
 }
 
-void EventProcessor::compute_intervals(bool print_intervals) {
-    std::cerr << "[WARN] Computing timestamp intervals...\n";
-    if (!root_) return;
-
-    std::vector<const Event*> evp;
-    evp.reserve(events_.size());
-    for (auto& e : events_) evp.push_back(&e);
-
-    std::sort(evp.begin(), evp.end(),
-              [](const Event* a, const Event* b){ return a->timestamp < b->timestamp; });
-
-    time_intervals_.clear();
-
-    uint64_t max_ts = 0;
-
-    for (const auto* e : evp) {
-        if (e->timestamp > max_ts)
-            max_ts = e->timestamp;
-
-        if (e->event == "fork" || e->event == "clone" || e->event == "clone3") {
-            root_->set_alive(e->child_pid);
-        }
-        else if (e->event == "exit") {
-            root_->set_dead(e->pid);
-        }
-        else if (e->event == "exit_group") {
-            root_->set_dead(e->parent_pid);
-        }
-
-        int old_alive = time_intervals_.empty() ? -1 : time_intervals_.back().alive;
-        int alive = root_->compute_alive();
-
-        if (time_intervals_.empty() || time_intervals_.back().alive != alive) {
-            DBG_PRINT(
-                "[DBG] ts=" << e->timestamp
-                << " event=" << e->event
-                << " pid=" << e->pid
-                << " parent_pid=" << e->parent_pid
-                << " alive=" << old_alive << " -> " << alive
-            );            
-            time_intervals_.push_back({ e->timestamp, alive });
-        }
-
-    }
-
-    if (!time_intervals_.empty() && time_intervals_.back().time < max_ts) {
-        int last_alive = time_intervals_.back().alive;
-        time_intervals_.push_back({ max_ts, last_alive });
-
-        int old_alive = time_intervals_.empty() ? -1 : time_intervals_.back().alive;
-    }
-
-    std::cerr << "[INFO] Computed " << time_intervals_.size() << " time intervals.\n";
-    if (print_intervals) {
-        std::cerr << "time,alive\n";
-        for (const auto& t : time_intervals_)
-            std::cerr << t.time << "," << t.alive << "\n";
-    }
-}
-
-
-void EventProcessor::store_to_csv(const std::string& filename) const {
-    std::ofstream f(filename);
-    f << "time,alive\n";
+void EventProcessor::store_to_csv(const std::string& filename, uint64_t origin_ns) const {
+    CsvWriter f;
+    if (!f.open(filename)) return;
+    f.put("time,alive\n");
     for (auto& p : time_intervals_) {
-        f << p.time << "," << p.alive << "\n";
+        f.put(p.time >= origin_ns ? p.time - origin_ns : 0).put(',').put(p.alive);
+        f.end_row();
     }
-    f.close();
+    if (!f.close()) return;
     std::cerr << "[INFO] Saved CSV to " << filename << "\n";
 }
@@ -1,6 +1,7 @@
 #include "SwitchProcessor.hpp"
+#include "CommTable.hpp"
 #include <iostream>
-#include <fstream>
+#include <thread>
 #include <map>
 #include <algorithm>
 #include <cmath>
@@ -14,80 +15,113 @@ static double unit_scale(const std::string& u) {
     throw std::invalid_argument("invalid time unit: " + u);
 }
 
-SwitchProcessor::SwitchProcessor(const std::vector<Event>& evs)
-: events_(evs) {
-    events_.erase(std::remove_if(events_.begin(), events_.end(),
-                                 [](const Event& e) {
-                                     return !(e.event == "run" || e.event == "desched");
-                                 }),
-                  events_.end());
+static bool is_switch_event(const Event& e) {
+    return e.kind == EventKind::Run || e.kind == EventKind::Desched || e.kind == EventKind::Slice;
 }
 
-void SwitchProcessor::build_slices(bool debug) {
-    std::cerr << "[SwitchProcessor] Processing " << events_.size() << " events\n";
-
-    std::map<uint32_t, std::tuple<uint64_t, uint32_t, std::string>> open;
-    slices_.clear();
-
-    for (const auto& e : events_) {
-        if (debug)
-            std::cerr << "[SwitchProcessor] Event: "
-                      << e.event << " pid=" << e.pid
-                      << " cpu=" << e.cpu
-                      << " ts=" << e.timestamp << "\n";
-
-        uint32_t pid = e.pid;
-        uint64_t ts  = e.timestamp;
-
-        if (e.event == "run") {
-            open[pid] = {ts, e.cpu, e.command};
-        } else if (e.event == "desched") {
-            auto it = open.find(pid);
-            if (it != open.end()) {
-                auto [start, cpu0, cmd0] = it->second;
-                if (ts > start) {
-                    Slice s{
-                        pid, cpu0, cmd0,
-                        start, ts, ts - start,
-                        e.reason
-                    };
-                    slices_.push_back(std::move(s));
-                }
-                open.erase(it);
-            }
+SwitchProcessor::SwitchProcessor(bool debug)
+: debug_(debug) {}
+
+static const char* SLICE_CSV_HEADER = "pid,cpu,command,start_ns,end_ns,delta_ns,reason\n";
+
+static void write_slice(CsvBuffer& f, const Slice& s, uint64_t origin_ns) {
+    f.put(s.pid).put(',').put(s.cpu).put(',').put(comm_name(s.comm)).put(',')
+     .put(s.start_ns >= origin_ns ? s.start_ns - origin_ns : 0).put(',')
+     .put(s.end_ns >= origin_ns ? s.end_ns - origin_ns : 0).put(',')
+     .put(s.delta_ns).put(',').put(switch_reason_name(s.reason)).put('\n');
+}
+
+bool SwitchProcessor::stream_to(const std::string& filename) {
+    if (!stream_.open(filename)) return false;
+    stream_path_ = filename;
+    stream_.put(SLICE_CSV_HEADER);
+    return true;
+}
+
+void SwitchProcessor::on_begin(uint32_t, uint64_t start_ns) {
+    stream_origin_ = start_ns;
+}
+
+void SwitchProcessor::add_slice(const Slice& s) {
+    ++slice_count_;
+    runtime_[std::make_tuple(s.cpu, s.pid, s.comm)] += s.delta_ns;
+    if (stream_.is_open()) {
+        uint64_t origin = stream_origin_;
+        stream_.write_rows(&s, 1, [origin](CsvBuffer& f, const Slice& x) { write_slice(f, x, origin); });
+    } else {
+        slices_.push_back(s);
+    }
+}
+
+void SwitchProcessor::on_event(const Event& e) {
+    if (!is_switch_event(e)) return;
+    ++switch_events_;
+    if (e.timestamp > end_ts_) end_ts_ = e.timestamp;
+
+    if (debug_)
+        std::cerr << "[SwitchProcessor] Event: "
+                  << event_kind_name(e.kind) << " pid=" << e.pid
+                  << " cpu=" << e.cpu
+                  << " ts=" << e.timestamp << "\n";
+
+    uint32_t pid = e.pid;
+    uint64_t ts  = e.timestamp;
+
+    if (e.kind == EventKind::Slice) {
+        // already paired by the kernel
+        if (ts > e.start)
+            add_slice(Slice{pid, e.cpu, e.comm, e.start, ts, ts - e.start, e.reason});
+    } else if (e.kind == EventKind::Run) {
+        open_[pid] = OpenRun{ts, e.cpu, e.comm};
+    } else if (e.kind == EventKind::Desched) {
+        auto it = open_.find(pid);
+        if (it != open_.end()) {
+            const OpenRun& r = it->second;
+            if (ts > r.start)
+                add_slice(Slice{pid, r.cpu, r.comm, r.start, ts, ts - r.start, e.reason});
+            open_.erase(it);
         }
     }
+}
 
+void SwitchProcessor::on_end() {
     // close any pending slices at the end of trace 
-    if (!open.empty()) {
-        uint64_t end_ts = 0;
-        for (const auto& e : events_)
-            if (e.timestamp > end_ts) end_ts = e.timestamp;
-
-        for (auto& [pid, tup] : open) {
-            auto [start, cpu0, cmd0] = tup;
-            Slice s{
-                pid, cpu0, cmd0,
-                start, end_ts, end_ts - start,
-                "end_of_trace"         
-            };
-            slices_.push_back(std::move(s));
-            std::cerr << "[SwitchProcessor] Closing pending slice for pid=" << pid << "\n";
-        }
-        open.clear();
+    for (auto& [pid, r] : open_) {
+        add_slice(Slice{
+            pid, r.cpu, r.comm,
+            r.start, end_ts_, end_ts_ - r.start,
+            SwitchReason::EndOfTrace
+        });
+        std::cerr << "[SwitchProcessor] Closing pending slice for pid=" << pid << "\n";
     }
+    open_.clear();
 
-    std::cerr << "[SwitchProcessor] Built " << slices_.size() << " slices\n";
+    std::cerr << "[SwitchProcessor] Built " << slice_count_ << " slices from "
+              << switch_events_ << " events";
+    if (stream_.is_open()) {
+        stream_.close();
+        std::cerr << ", streamed to " << stream_path_;
+    }
+    std::cerr << "\n";
 }
 
-void SwitchProcessor::store_csv(const std::string& filename) const {
-    std::ofstream f(filename);
-    f << "pid,cpu,command,start_ns,end_ns,delta_ns,reason\n";
-    for (const auto& s : slices_) {
-        f << s.pid << "," << s.cpu << "," << s.command << ","
-          << s.start_ns << "," << s.end_ns << ","
-          << s.delta_ns << "," << s.reason << "\n";
-    }
+void SwitchProcessor::load_summary(const std::vector<RuntimeStat>& stats) {
+    summary_ = stats;
+    uint64_t switches = 0;
+    for (const auto& s : summary_) switches += s.switches;
+    std::cerr << "[SwitchProcessor] Loaded " << summary_.size()
+              << " per-thread runtime entries (" << switches << " switches)\n";
+}
+
+void SwitchProcessor::store_csv(const std::string& filename, uint64_t origin_ns) const {
+    CsvWriter f;
+    if (!f.open(filename)) return;
+    f.put(SLICE_CSV_HEADER);
+    // comm names are only read here, CommTable lookups are thread-safe
+    f.write_rows(slices_.data(), slices_.size(),
+                 [origin_ns](CsvBuffer& b, const Slice& s) { write_slice(b, s, origin_ns); },
+                 std::max(1u, std::thread::hardware_concurrency()));
+    if (!f.close()) return;
     std::cerr << "[SwitchProcessor] Stored " << slices_.size()
               << " slices into " << filename << "\n";
 }
@@ -95,25 +129,25 @@ void SwitchProcessor::store_csv(const std::string& filename) const {
 void SwitchProcessor::plot_top_runtime_per_cpu(int top_n,
                                                const std::string& time_unit,
                                                const std::string& outfile_prefix) const {
-    if (slices_.empty()) {
+    (void)outfile_prefix;   // the report goes to the terminal only
+    if (runtime_.empty() && summary_.empty()) {
         std::cerr << "[SwitchProcessor] No slices; nothing to plot\n";
         return;
     }
 
     double scale = unit_scale(time_unit);
     // aggregate total runtime per (cpu,pid,command) 
-    std::map<std::tuple<uint32_t, uint32_t, std::string>, uint64_t> agg;
-
-    for (const auto& s : slices_) {
-        auto key = std::make_tuple(s.cpu, s.pid, s.command);
-        agg[key] += s.delta_ns;
+    auto agg = runtime_;
+    for (const auto& s : summary_) {
+        auto key = std::make_tuple(s.cpu, s.tid, s.comm);
+        agg[key] += s.oncpu_ns;
     }
 
     // top per CPU
     std::map<uint32_t, std::vector<std::pair<std::string, double>>> per_cpu;
     for (const auto& [k, tot_ns] : agg) {
         auto [cpu, pid, cmd] = k;
-        std::string label = cmd + ":" + std::to_string(pid);
+        std::string label = comm_name(cmd) + ":" + std::to_string(pid);
         per_cpu[cpu].push_back({label, tot_ns / scale});
     }
 
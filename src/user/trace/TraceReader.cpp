@@ -0,0 +1,192 @@
+#include "TraceReader.hpp"
+#include "CommTable.hpp"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+TraceReader::~TraceReader() {
+    close();
+}
+
+void TraceReader::close() {
+    if (base_) munmap(const_cast<uint8_t*>(base_), size_);
+    base_ = nullptr;
+    size_ = 0;
+    index_.clear();
+    comm_ids_.clear();
+    summary_.clear();
+}
+
+bool TraceReader::fail(const char* what) {
+    fprintf(stderr, "[trace] %s: %s\n", path_.c_str(), what);
+    close();
+    return false;
+}
+
+bool TraceReader::open(const std::string& path) {
+    close();
+    path_ = path;
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        fprintf(stderr, "[trace] open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        ::close(fd);
+        return fail("stat failed");
+    }
+    size_ = (size_t)st.st_size;
+    if (size_ < sizeof(TraceFileHeader) + sizeof(TraceFileTrailer)) {
+        ::close(fd);
+        return fail("not a trace file");
+    }
+    void* map = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (map == MAP_FAILED) {
+        size_ = 0;
+        return fail("mmap failed");
+    }
+    base_ = static_cast<const uint8_t*>(map);
+
+    memcpy(&header_, base_, sizeof(header_));
+    if (memcmp(header_.magic, TMT_TRACE_MAGIC, sizeof(header_.magic)) != 0)
+        return fail("not a trace file");
+    if (header_.version != TMT_TRACE_VERSION)
+        return fail("unsupported trace version");
+
+    TraceFileTrailer t;
+    memcpy(&t, base_ + size_ - sizeof(t), sizeof(t));
+    if (memcmp(t.magic, TMT_TRACE_END_MAGIC, sizeof(t.magic)) != 0)
+        return fail("missing trailer (truncated trace?)");
+    size_t end = size_ - sizeof(t);
+    if (t.dict_offset > t.summary_offset || t.summary_offset > t.index_offset ||
+        t.index_offset + (uint64_t)t.chunks * sizeof(TraceChunkInfo) != end)
+        return fail("corrupt trailer");
+    events_ = t.events;
+
+    // dictionary, interned once so decoded events carry CommTable ids
+    const uint8_t* p = base_ + t.dict_offset;
+    const uint8_t* dict_end = base_ + t.summary_offset;
+    uint32_t n;
+    if (p + sizeof(n) > dict_end) return fail("corrupt dictionary");
+    memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    comm_ids_.reserve(n);
+    auto& table = CommTable::instance();
+    for (uint32_t i = 0; i < n; ++i) {
+        if (p >= dict_end || p + 1 + *p > dict_end) return fail("corrupt dictionary");
+        uint8_t len = *p++;
+        comm_ids_.push_back(table.intern(std::string(reinterpret_cast<const char*>(p), len)));
+        p += len;
+    }
+
+    p = base_ + t.summary_offset;
+    if (p + sizeof(n) > base_ + t.index_offset) return fail("corrupt summary");
+    memcpy(&n, p, sizeof(n));
+    p += sizeof(n);
+    if (p + (uint64_t)n * sizeof(TraceRuntimeStat) > base_ + t.index_offset)
+        return fail("corrupt summary");
+    summary_.reserve(n);
+    for (uint32_t i = 0; i < n; ++i, p += sizeof(TraceRuntimeStat)) {
+        TraceRuntimeStat r;
+        memcpy(&r, p, sizeof(r));
+        RuntimeStat s;
+        s.tid = r.tid;
+        s.cpu = r.cpu;
+        s.comm = r.comm < comm_ids_.size() ? comm_ids_[r.comm] : 0;
+        s.oncpu_ns = r.oncpu_ns;
+        s.switches = r.switches;
+        s.voluntary = r.voluntary;
+        s.involuntary = r.involuntary;
+        summary_.push_back(s);
+    }
+
+    index_.resize(t.chunks);
+    memcpy(index_.data(), base_ + t.index_offset, t.chunks * sizeof(TraceChunkInfo));
+    for (const auto& c : index_)
+        if (c.offset < sizeof(TraceFileHeader) || c.offset + c.size > t.dict_offset)
+            return fail("corrupt chunk index");
+
+    madvise(map, size_, MADV_RANDOM);
+    return true;
+}
+
+std::vector<size_t> TraceReader::chunks_in(uint64_t from, uint64_t to) const {
+    std::vector<size_t> out;
+    for (size_t i = 0; i < index_.size(); ++i)
+        if (index_[i].t_max >= from && index_[i].t_min <= to) out.push_back(i);
+    return out;
+}
+
+bool TraceReader::chunk_may_contain(size_t i, uint32_t pid) const {
+    const auto& c = index_[i];
+    if (pid < c.pid_min || pid > c.pid_max) return false;
+    return c.pid_mask & (1ull << trace_pid_bit(pid));
+}
+
+bool TraceReader::read_chunk(size_t i, std::vector<Event>& out) const {
+    const auto& c = index_[i];
+    const uint8_t* p = base_ + c.offset;
+    const uint8_t* end = p + c.size;
+
+    uint32_t lens[TCOL_MAX];
+    if (p + sizeof(lens) > end) return false;
+    memcpy(lens, p, sizeof(lens));
+    p += sizeof(lens);
+
+    const uint8_t* col[TCOL_MAX];
+    const uint8_t* col_end[TCOL_MAX];
+    for (int k = 0; k < TCOL_MAX; ++k) {
+        if (p + lens[k] > end) return false;
+        col[k] = p;
+        col_end[k] = p + lens[k];
+        p += lens[k];
+    }
+    if (lens[TCOL_KIND] < c.count || lens[TCOL_REASON] < c.count) return false;
+
+    size_t first = out.size();
+    out.resize(first + c.count);
+    Event prev{};
+    for (uint32_t n = 0; n < c.count; ++n) {
+        Event& e = out[first + n];
+        uint64_t v[TCOL_MAX];
+        for (int k = TCOL_CPU; k < TCOL_MAX; ++k) {
+            if (!get_varint(col[k], col_end[k], v[k])) {
+                out.resize(first);
+                return false;
+            }
+        }
+        e.kind = static_cast<EventKind>(col[TCOL_KIND][n]);
+        e.reason = static_cast<SwitchReason>(col[TCOL_REASON][n]);
+        e.cpu = (uint32_t)v[TCOL_CPU];
+        e.pid = (uint32_t)(prev.pid + unzigzag(v[TCOL_PID]));
+        e.parent_pid = (uint32_t)(prev.parent_pid + unzigzag(v[TCOL_PARENT_PID]));
+        e.child_pid = (uint32_t)(prev.child_pid + unzigzag(v[TCOL_CHILD_PID]));
+        e.tid = (uint32_t)(prev.tid + unzigzag(v[TCOL_TID]));
+        e.tgid = (uint32_t)(prev.tgid + unzigzag(v[TCOL_TGID]));
+        e.comm = v[TCOL_COMM] < comm_ids_.size() ? comm_ids_[v[TCOL_COMM]] : 0;
+        e.timestamp = prev.timestamp + (uint64_t)unzigzag(v[TCOL_TIMESTAMP]);
+        e.start = e.kind == EventKind::Slice ? e.timestamp - (uint64_t)unzigzag(v[TCOL_START]) : 0;
+        prev = e;
+    }
+    return true;
+}
+
+std::vector<Event> TraceReader::read_all() const {
+    std::vector<Event> out;
+    out.reserve(events_);
+    for (size_t i = 0; i < index_.size(); ++i) {
+        if (!read_chunk(i, out)) {
+            fprintf(stderr, "[trace] %s: chunk %zu is corrupt, stopping there\n",
+                    path_.c_str(), i);
+            break;
+        }
+    }
+    return out;
+}
@@ -0,0 +1,178 @@
+#include "TraceWriter.hpp"
+#include "CommTable.hpp"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+
+TraceWriter::~TraceWriter() {
+    close();
+}
+
+bool TraceWriter::open(const std::string& path, uint32_t root_pid, uint64_t origin_ns) {
+    fp_ = fopen(path.c_str(), "wb");
+    if (!fp_) {
+        fprintf(stderr, "[trace] open %s failed: %s\n", path.c_str(), strerror(errno));
+        return false;
+    }
+    path_ = path;
+    offset_ = 0;
+    events_ = 0;
+    failed_ = false;
+    index_.clear();
+    dict_ids_.clear();
+    dict_.assign(1, 0);         // id 0 is the empty name, as in CommTable
+    dict_ids_.emplace(0, 0);
+    pending_.clear();
+    pending_.reserve(TMT_TRACE_CHUNK_EVENTS);
+
+    header_ = TraceFileHeader{};
+    memcpy(header_.magic, TMT_TRACE_MAGIC, sizeof(header_.magic));
+    header_.version = TMT_TRACE_VERSION;
+    header_.root_pid = root_pid;
+    header_.origin_ns = origin_ns;
+    return write(&header_, sizeof(header_));
+}
+
+void TraceWriter::on_begin(uint32_t root_pid, uint64_t start_ns) {
+    if (root_pid) header_.root_pid = root_pid;
+    header_.origin_ns = start_ns;
+}
+
+bool TraceWriter::write(const void* data, size_t len) {
+    if (failed_) return false;
+    if (len && fwrite(data, 1, len, fp_) != len) {
+        fprintf(stderr, "[trace] write to %s failed: %s\n", path_.c_str(), strerror(errno));
+        failed_ = true;
+        return false;
+    }
+    offset_ += len;
+    return true;
+}
+
+uint32_t TraceWriter::dict_id(uint32_t comm) {
+    auto it = dict_ids_.find(comm);
+    if (it != dict_ids_.end()) return it->second;
+    uint32_t id = static_cast<uint32_t>(dict_.size());
+    dict_.push_back(comm);
+    dict_ids_.emplace(comm, id);
+    return id;
+}
+
+void TraceWriter::append(const Event& e) {
+    pending_.push_back(e);
+    if (pending_.size() >= TMT_TRACE_CHUNK_EVENTS) flush_chunk();
+}
+
+void TraceWriter::append(EventSpan events) {
+    for (const auto& e : events) append(e);
+}
+
+void TraceWriter::set_summary(const std::vector<RuntimeStat>& stats) {
+    summary_ = stats;
+    header_.flags |= TMT_TRACE_SUMMARY;
+}
+
+void TraceWriter::flush_chunk() {
+    if (pending_.empty()) return;
+    for (auto& c : cols_) c.clear();
+
+    TraceChunkInfo info{};
+    info.offset = offset_;
+    info.count = static_cast<uint32_t>(pending_.size());
+    info.t_min = UINT64_MAX;
+    info.pid_min = UINT32_MAX;
+
+    Event prev{};
+    for (const auto& e : pending_) {
+        cols_[TCOL_KIND].push_back(static_cast<uint8_t>(e.kind));
+        cols_[TCOL_REASON].push_back(static_cast<uint8_t>(e.reason));
+        put_varint(cols_[TCOL_CPU], e.cpu);
+        put_varint(cols_[TCOL_PID], zigzag((int64_t)e.pid - prev.pid));
+        put_varint(cols_[TCOL_PARENT_PID], zigzag((int64_t)e.parent_pid - prev.parent_pid));
+        put_varint(cols_[TCOL_CHILD_PID], zigzag((int64_t)e.child_pid - prev.child_pid));
+        put_varint(cols_[TCOL_TID], zigzag((int64_t)e.tid - prev.tid));
+        put_varint(cols_[TCOL_TGID], zigzag((int64_t)e.tgid - prev.tgid));
+        put_varint(cols_[TCOL_COMM], dict_id(e.comm));
+        put_varint(cols_[TCOL_TIMESTAMP], zigzag((int64_t)(e.timestamp - prev.timestamp)));
+        put_varint(cols_[TCOL_START],
+                   e.kind == EventKind::Slice ? zigzag((int64_t)(e.timestamp - e.start)) : 0);
+        prev = e;
+
+        uint64_t lo = e.kind == EventKind::Slice ? std::min(e.start, e.timestamp) : e.timestamp;
+        info.t_min = std::min(info.t_min, lo);
+        info.t_max = std::max(info.t_max, e.timestamp);
+        for (uint32_t pid : {e.pid, e.tid}) {
+            if (!pid) continue;
+            info.pid_min = std::min(info.pid_min, pid);
+            info.pid_max = std::max(info.pid_max, pid);
+            info.pid_mask |= 1ull << trace_pid_bit(pid);
+        }
+    }
+    if (info.pid_min > info.pid_max) info.pid_min = info.pid_max = 0;
+
+    uint32_t lens[TCOL_MAX];
+    for (int c = 0; c < TCOL_MAX; ++c) lens[c] = static_cast<uint32_t>(cols_[c].size());
+    write(lens, sizeof(lens));
+    for (auto& c : cols_) write(c.data(), c.size());
+    info.size = static_cast<uint32_t>(offset_ - info.offset);
+
+    index_.push_back(info);
+    events_ += pending_.size();
+    pending_.clear();
+}
+
+bool TraceWriter::close() {
+    if (!fp_) return !failed_;
+    flush_chunk();
+
+    TraceFileTrailer t{};
+
+    // summary first: it may add comms to the dictionary
+    std::vector<TraceRuntimeStat> stats;
+    stats.reserve(summary_.size());
+    for (const auto& s : summary_) {
+        TraceRuntimeStat r{};
+        r.tid = s.tid;
+        r.cpu = s.cpu;
+        r.comm = dict_id(s.comm);
+        r.oncpu_ns = s.oncpu_ns;
+        r.switches = s.switches;
+        r.voluntary = s.voluntary;
+        r.involuntary = s.involuntary;
+        stats.push_back(r);
+    }
+
+    t.dict_offset = offset_;
+    uint32_t n = static_cast<uint32_t>(dict_.size());
+    write(&n, sizeof(n));
+    for (uint32_t comm : dict_) {
+        const std::string& name = comm_name(comm);
+        uint8_t len = static_cast<uint8_t>(std::min<size_t>(name.size(), 255));
+        write(&len, 1);
+        write(name.data(), len);
+    }
+
+    t.summary_offset = offset_;
+    n = static_cast<uint32_t>(stats.size());
+    write(&n, sizeof(n));
+    write(stats.data(), stats.size() * sizeof(TraceRuntimeStat));
+
+    t.index_offset = offset_;
+    write(index_.data(), index_.size() * sizeof(TraceChunkInfo));
+
+    t.events = events_;
+    t.chunks = static_cast<uint32_t>(index_.size());
+    memcpy(t.magic, TMT_TRACE_END_MAGIC, sizeof(t.magic));
+    write(&t, sizeof(t));
+
+    // flags, root and origin may have changed since open()
+    if (!failed_) {
+        if (fseek(fp_, 0, SEEK_SET) != 0 ||
+            fwrite(&header_, sizeof(header_), 1, fp_) != 1)
+            failed_ = true;
+    }
+
+    if (fclose(fp_) != 0) failed_ = true;
+    fp_ = nullptr;
+    return !failed_;
+}
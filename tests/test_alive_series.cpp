@@ -0,0 +1,53 @@
+/* A clone child is reported twice, by sched_process_fork and by the
+ * clone exit in the parent; the alive series must count it once. */
+#include "EventProcessor.hpp"
+#include "CommTable.hpp"
+#include <cstdio>
+#include <fstream>
+#include <string>
+
+static Event make(EventKind kind, uint64_t ts, uint32_t pid, uint32_t child = 0) {
+    Event e;
+    e.kind = kind;
+    e.timestamp = ts;
+    e.pid = pid;
+    e.tid = pid;
+    e.child_pid = child;
+    e.comm = CommTable::instance().intern("test");
+    return e;
+}
+
+static int check_clone_counted_once(const char* csv, EventKind second) {
+    EventProcessor ep(100);
+    ep.on_begin(100, 0);
+    ep.on_event(make(EventKind::ExecveEntry, 1, 100));
+    ep.on_event(make(EventKind::Fork, 2, 100, 101));
+    ep.on_event(make(second, 3, 100, 101));
+    ep.on_event(make(EventKind::Exit, 4, 101));
+    ep.on_event(make(EventKind::ExecveEntry, 5, 100));
+    ep.on_end();
+    ep.store_to_csv(csv);
+
+    std::ifstream in(csv);
+    std::string line;
+    std::getline(in, line);     // header
+    int peak = 0, last = -1;
+    while (std::getline(in, line)) {
+        int alive = std::stoi(line.substr(line.find(',') + 1));
+        if (alive > peak) peak = alive;
+        last = alive;
+    }
+    std::remove(csv);
+    if (peak != 2 || last != 1) {
+        fprintf(stderr, "FAIL: %s after fork: peak %d, last %d (want 2, 1)\n",
+                event_kind_name(second), peak, last);
+        return 1;
+    }
+    return 0;
+}
+
+int main() {
+    int failed = check_clone_counted_once("test_alive_clone.csv", EventKind::Clone);
+    if (!failed) printf("alive series: clone child counted once\n");
+    return failed;
+}
@@ -0,0 +1,72 @@
+/* CsvWriter: rows formatted on several threads, or through a buffer that
+ * is flushed many times over, must give the same bytes as formatting them
+ * one by one with stdio. */
+#include "CsvWriter.hpp"
+#include <cinttypes>
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Row {
+    uint64_t time;
+    uint32_t cpu;
+    int32_t delta;
+};
+
+static void fmt(CsvBuffer& f, const Row& r) {
+    f.put(r.time).put(',').put(r.cpu).put(',').put(r.delta).put(",x\n");
+}
+
+static std::string slurp(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return ss.str();
+}
+
+int main() {
+    // more 64k-row blocks than one round of four threads takes
+    const size_t n = 300 * 1000;
+    std::vector<Row> rows(n);
+    std::string want = "time,cpu,delta,tag\n";
+    char line[96];
+    for (size_t i = 0; i < n; ++i) {
+        int32_t d = (int32_t)i;
+        rows[i] = {UINT64_MAX - i * 7919, (uint32_t)(i % 97), i % 2 ? -d : d};
+        snprintf(line, sizeof(line), "%" PRIu64 ",%u,%d,x\n", rows[i].time, rows[i].cpu, rows[i].delta);
+        want += line;
+    }
+
+    int failed = 0;
+    struct { const char* name; size_t flush_bytes; unsigned threads; } cases[] = {
+        {"one thread", 1 << 20, 1},
+        {"four threads", 1 << 20, 4},
+        {"small buffer", 100, 1},
+    };
+    for (const auto& c : cases) {
+        const char* path = "test_csv_writer.csv";
+        CsvWriter w(c.flush_bytes);
+        if (!w.open(path)) return 1;
+        w.put("time,cpu,delta,tag");
+        w.end_row();
+        w.write_rows(rows.data(), rows.size(), fmt, c.threads);
+        if (!w.close()) {
+            fprintf(stderr, "FAIL: %s: close reported a write error\n", c.name);
+            failed = 1;
+        }
+        std::string got = slurp(path);
+        std::remove(path);
+        if (got != want) {
+            size_t at = 0;
+            while (at < got.size() && at < want.size() && got[at] == want[at]) ++at;
+            fprintf(stderr, "FAIL: %s: %zu bytes, first difference at %zu (want %zu bytes)\n",
+                    c.name, got.size(), at, want.size());
+            failed = 1;
+        }
+    }
+
+    if (!failed) printf("csv writer: same bytes on every path\n");
+    return failed;
+}
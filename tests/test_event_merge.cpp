@@ -0,0 +1,101 @@
+/* merge_events must return every event in timestamp order; equal
+ * timestamps keep the order of part, then CPU, then position in the part.
+ * Runs are nearly sorted, as the ring buffer delivers them, or have a
+ * record displaced further than the insertion-sort repair goes. */
+#include "EventMerge.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <tuple>
+#include <vector>
+
+struct Key {
+    uint64_t ts;
+    size_t part;
+    uint32_t cpu;
+    uint32_t id;
+};
+
+static int check(const char* name, std::vector<std::vector<Event>> parts) {
+    // id: position in the part; Key order is the order merge_events keeps
+    std::vector<Key> want;
+    for (size_t p = 0; p < parts.size(); ++p)
+        for (uint32_t i = 0; i < parts[p].size(); ++i) {
+            parts[p][i].pid = i;
+            want.push_back({parts[p][i].timestamp, p, parts[p][i].cpu, i});
+        }
+    std::sort(want.begin(), want.end(), [](const Key& a, const Key& b) {
+        return std::tie(a.ts, a.part, a.cpu, a.id) < std::tie(b.ts, b.part, b.cpu, b.id);
+    });
+
+    std::vector<Event> out = merge_events(parts);
+    for (const auto& p : parts) {
+        if (!p.empty()) {
+            fprintf(stderr, "FAIL: %s: input not released\n", name);
+            return 1;
+        }
+    }
+    if (out.size() != want.size()) {
+        fprintf(stderr, "FAIL: %s: %zu events out of %zu\n", name, out.size(), want.size());
+        return 1;
+    }
+    for (size_t i = 0; i < out.size(); ++i) {
+        if (out[i].timestamp != want[i].ts || out[i].cpu != want[i].cpu || out[i].pid != want[i].id) {
+            fprintf(stderr, "FAIL: %s: event %zu is ts %llu cpu %u #%u (want ts %llu cpu %u #%u)\n",
+                    name, i, (unsigned long long)out[i].timestamp, out[i].cpu, out[i].pid,
+                    (unsigned long long)want[i].ts, want[i].cpu, want[i].id);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* n events per CPU, interleaved; neighbours swap with probability 1/swap_one_in,
+ * and ties are common */
+static std::vector<Event> nearly_sorted(std::mt19937_64& rng, unsigned ncpu, size_t n,
+                                        unsigned swap_one_in) {
+    std::vector<Event> part;
+    for (size_t i = 0; i < n * ncpu; ++i) {
+        Event e;
+        e.cpu = rng() % ncpu;
+        e.timestamp = 1000 + i * 4 + rng() % 3;
+        part.push_back(e);
+    }
+    for (size_t i = 1; i < part.size(); ++i)
+        if (rng() % swap_one_in == 0) std::swap(part[i - 1].timestamp, part[i].timestamp);
+    return part;
+}
+
+int main() {
+    std::mt19937_64 rng(42);
+    int failed = 0;
+
+    failed |= check("empty", {{}, {}});
+    failed |= check("nearly sorted", {nearly_sorted(rng, 4, 5000, 8),
+                                      nearly_sorted(rng, 3, 5000, 8),
+                                      {}});
+
+    // a record far behind its place: past REPAIR_WINDOW the run is
+    // stable-sorted instead
+    for (size_t back : {10, 255, 256, 257, 5000}) {
+        std::vector<Event> part = nearly_sorted(rng, 1, 20000, 16);
+        part[15000].timestamp = part[15000 - back].timestamp - 1;
+        auto other = nearly_sorted(rng, 2, 3000, 16);
+        other[100].timestamp = 0;
+        char name[64];
+        snprintf(name, sizeof(name), "record %zu places back", back);
+        failed |= check(name, {std::move(part), std::move(other)});
+    }
+
+    // equal timestamps everywhere: only the stable order decides
+    std::vector<Event> flat(3000), flat2(3000);
+    for (size_t i = 0; i < flat.size(); ++i) {
+        flat[i].cpu = flat2[i].cpu = i % 3;
+        flat[i].timestamp = flat2[i].timestamp = 7;
+    }
+    flat[2999].timestamp = 6;
+    failed |= check("ties", {std::move(flat), std::move(flat2)});
+
+    if (!failed) printf("event merge: ordered and stable\n");
+    return failed;
+}
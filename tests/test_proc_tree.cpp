@@ -0,0 +1,132 @@
+/* ProcTree against the recursive Node tree it replaced: random forks,
+ * exits and exit_groups over a small pid space, so that pids are reused
+ * and nested under themselves, must give the same alive count and tree
+ * size after every event. */
+#include "ProcTree.hpp"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+/* the tree EventProcessor used before ProcTree, walked on every query */
+struct Node {
+    uint32_t pid;
+    uint32_t comm;
+    bool alive{false};
+    std::vector<Node> children;
+
+    Node(uint32_t pid_, uint32_t comm_, bool alive_ = false)
+        : pid(pid_), comm(comm_), alive(alive_) {}
+
+    int size() const {
+        int total = 1;
+        for (const auto& c : children)
+            total += c.size();
+        return total;
+    }
+
+    int compute_alive() const {
+        if (!alive) return 0;
+        int total = 1;
+        for (const auto& c : children)
+            total += c.compute_alive();
+        return total;
+    }
+
+    void set_alive(uint32_t target_pid) {
+        if (pid == target_pid) {
+            alive = true;
+            return;
+        }
+        for (auto& c : children)
+            c.set_alive(target_pid);
+    }
+
+    void kill_all() {
+        alive = false;
+        for (auto& c : children)
+            c.kill_all();
+    }
+
+    void set_dead(uint32_t target_pid) {
+        if (pid == target_pid) {
+            kill_all();
+        } else {
+            for (auto& c : children)
+                c.set_dead(target_pid);
+        }
+    }
+
+    bool add_child(const Event& e) {
+        if (e.kind == EventKind::Fork) {
+            if (e.pid == pid) {
+                children.emplace_back(e.child_pid, e.comm);
+                return true;
+            } else {
+                for (auto& c : children)
+                    if (c.add_child(e))
+                        return true;
+            }
+        }
+        return false;
+    }
+};
+
+/* the updates EventProcessor::on_event makes for one event */
+template <class Tree>
+static void apply(Tree& t, const Event& e) {
+    if (e.kind == EventKind::Fork) {
+        t.add_child(e);
+        t.set_alive(e.child_pid);
+    } else if (e.kind == EventKind::Exit) {
+        t.set_dead(e.pid);
+    } else if (e.kind == EventKind::ExitGroup) {
+        t.set_dead(e.parent_pid);
+    }
+}
+
+static int run(uint64_t seed, uint32_t npids, int nevents) {
+    std::mt19937_64 rng(seed);
+    const uint32_t root = 1;
+
+    Node old(root, 0, true);
+    ProcTree tree;
+    tree.add(root, 0, ProcTree::NONE);
+    tree.set_alive(root);
+
+    for (int i = 0; i < nevents; ++i) {
+        Event e;
+        e.timestamp = i + 1;
+        e.pid = 1 + rng() % npids;
+        unsigned r = rng() % 10;
+        if (r < 6) {
+            e.kind = EventKind::Fork;
+            e.child_pid = 1 + rng() % npids;
+        } else if (r < 9) {
+            e.kind = EventKind::Exit;
+        } else {
+            e.kind = EventKind::ExitGroup;
+            e.parent_pid = 1 + rng() % npids;
+        }
+        apply(old, e);
+        apply(tree, e);
+
+        int want = old.compute_alive(), got = tree.alive_count;
+        int want_nodes = old.size(), got_nodes = (int)tree.nodes.size();
+        if (want != got || want_nodes != got_nodes) {
+            fprintf(stderr, "FAIL: seed %llu, event %d (%s pid %u): alive %d, %d nodes "
+                            "(want %d, %d)\n",
+                    (unsigned long long)seed, i, event_kind_name(e.kind), e.pid,
+                    got, got_nodes, want, want_nodes);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+int main() {
+    int failed = 0;
+    for (uint64_t seed = 1; seed <= 200 && !failed; ++seed)
+        failed |= run(seed, 4 + seed % 13, 300);
+    if (!failed) printf("proc tree: matches the recursive tree\n");
+    return failed;
+}
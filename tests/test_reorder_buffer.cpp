@@ -0,0 +1,120 @@
+/* ReorderBuffer with a pool too small for the stream: the oldest events
+ * go out early, each event that found the pool full is counted once, and
+ * the output stays in timestamp order. */
+#include "ReorderBuffer.hpp"
+#include <cstdio>
+#include <random>
+#include <vector>
+
+struct Collect : EventSink {
+    std::vector<Event> events;
+    void on_event(const Event& e) override { events.push_back(e); }
+};
+
+static Event at(uint32_t cpu, uint64_t ts) {
+    Event e;
+    e.cpu = cpu;
+    e.timestamp = ts;
+    return e;
+}
+
+static int ordered(const char* name, const Collect& out, size_t want) {
+    if (out.events.size() != want) {
+        fprintf(stderr, "FAIL: %s: %zu events out of %zu\n", name, out.events.size(), want);
+        return 1;
+    }
+    for (size_t i = 1; i < out.events.size(); ++i) {
+        if (out.events[i].timestamp < out.events[i - 1].timestamp) {
+            fprintf(stderr, "FAIL: %s: event %zu out of order\n", name, i);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* one CPU, a pool of two chunks: every event that needs a third chunk
+ * releases a whole chunk of the oldest, one event at a time */
+static int forced_once_per_event() {
+    const size_t CAP = EventChunk::CAP;
+    const size_t n = 2 * CAP + 3 * CAP + 10;
+    Collect out;
+    ReorderBuffer rb(out, 1, 0, 0);
+    for (size_t i = 0; i < n; ++i) rb.on_event(at(0, 100 + i));
+
+    int failed = 0;
+    // events 2, 3, 4 and 5 * CAP found the pool full
+    if (rb.forced() != 4 || rb.late() != 0) {
+        fprintf(stderr, "FAIL: pool pressure: forced %llu, late %llu (want 4, 0)\n",
+                (unsigned long long)rb.forced(), (unsigned long long)rb.late());
+        failed = 1;
+    }
+    if (rb.pool().capacity() != 2 || rb.pool().peak() != 2) {
+        fprintf(stderr, "FAIL: pool pressure: peak %zu of %zu chunks (want 2 of 2)\n",
+                rb.pool().peak(), rb.pool().capacity());
+        failed = 1;
+    }
+    if (out.events.size() != 4 * CAP || rb.pending() != n - 4 * CAP) {
+        fprintf(stderr, "FAIL: pool pressure: %zu released early, %zu pending\n",
+                out.events.size(), rb.pending());
+        failed = 1;
+    }
+    rb.flush();
+    failed |= ordered("pool pressure", out, n);
+    return failed;
+}
+
+/* several CPUs interleaved under the same pressure, each CPU with its
+ * own pace */
+static int forced_across_cpus() {
+    const unsigned ncpu = 4;
+    const size_t n = 20 * EventChunk::CAP;
+    std::mt19937_64 rng(7);
+    Collect out;
+    ReorderBuffer rb(out, ncpu, 0, 0);
+    for (size_t i = 0; i < n; ++i)
+        rb.on_event(at(rng() % ncpu, 1000 + i * 8));
+    rb.flush();
+
+    int failed = ordered("pool pressure, 4 CPUs", out, n);
+    if (!rb.forced() || rb.forced() > n || rb.late()) {
+        fprintf(stderr, "FAIL: pool pressure, 4 CPUs: forced %llu, late %llu\n",
+                (unsigned long long)rb.forced(), (unsigned long long)rb.late());
+        failed = 1;
+    }
+    if (rb.pool().in_use() != 0) {
+        fprintf(stderr, "FAIL: pool pressure, 4 CPUs: %zu chunks still in use\n",
+                rb.pool().in_use());
+        failed = 1;
+    }
+    return failed;
+}
+
+/* an event older than what was already released is passed on and counted */
+static int late_event() {
+    Collect out;
+    ReorderBuffer rb(out, 2, 10);
+    rb.on_event(at(0, 100));
+    rb.on_event(at(1, 120));
+    rb.advance(200);                    // watermark 190
+    rb.on_event(at(0, 110));
+    rb.on_event(at(1, 300));
+    rb.flush();
+
+    int failed = 0;
+    if (rb.late() != 1 || rb.forced() != 0 || out.events.size() != 4 ||
+        out.events[2].timestamp != 110) {
+        fprintf(stderr, "FAIL: late event: late %llu, forced %llu, %zu events\n",
+                (unsigned long long)rb.late(), (unsigned long long)rb.forced(),
+                out.events.size());
+        failed = 1;
+    }
+    return failed;
+}
+
+int main() {
+    int failed = forced_once_per_event();
+    failed |= forced_across_cpus();
+    failed |= late_event();
+    if (!failed) printf("reorder buffer: ordered under pool pressure\n");
+    return failed;
+}
@@ -0,0 +1,144 @@
+/* A .tmt trace read back must give the events and the runtime summary
+ * that were written, field by field, and an index that finds them. */
+#include "TraceWriter.hpp"
+#include "TraceReader.hpp"
+#include "CommTable.hpp"
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+#include <vector>
+
+static bool same(const Event& a, const Event& b) {
+    return a.kind == b.kind && a.reason == b.reason && a.cpu == b.cpu &&
+           a.parent_pid == b.parent_pid && a.pid == b.pid && a.child_pid == b.child_pid &&
+           a.tid == b.tid && a.tgid == b.tgid && a.comm == b.comm &&
+           a.timestamp == b.timestamp && (a.kind != EventKind::Slice || a.start == b.start);
+}
+
+static std::vector<Event> make_events(size_t n) {
+    std::mt19937_64 rng(3);
+    const char* names[] = {"tmt", "worker", "a-rather-long-nm", ""};
+    std::vector<Event> evs;
+    uint64_t ts = 1ull << 40;
+    for (size_t i = 0; i < n; ++i) {
+        Event e;
+        e.kind = static_cast<EventKind>(1 + rng() % 9);
+        e.reason = static_cast<SwitchReason>(rng() % 4);
+        e.cpu = rng() % 64;
+        e.pid = 1000 + rng() % 5000;
+        e.tid = rng() % 2 ? e.pid : 1000 + rng() % 5000;
+        e.tgid = e.pid;
+        e.parent_pid = rng() % 3 ? 0 : 1000 + rng() % 5000;
+        e.child_pid = e.kind == EventKind::Fork ? e.pid + 1 : 0;
+        e.comm = CommTable::instance().intern(names[rng() % 4]);
+        ts += rng() % 100000;
+        e.timestamp = ts;
+        if (e.kind == EventKind::Slice) e.start = ts - rng() % 5000000;
+        evs.push_back(e);
+    }
+    return evs;
+}
+
+int main() {
+    const char* path = "test_roundtrip.tmt";
+    const size_t n = 2 * TMT_TRACE_CHUNK_EVENTS + 123;
+    std::vector<Event> evs = make_events(n);
+
+    std::vector<RuntimeStat> stats(2);
+    stats[0].tid = 1001; stats[0].cpu = 3; stats[0].comm = CommTable::instance().intern("worker");
+    stats[0].oncpu_ns = 123456789; stats[0].switches = 10;
+    stats[0].voluntary = 7; stats[0].involuntary = 3;
+    stats[1].tid = 1002; stats[1].cpu = 0; stats[1].comm = CommTable::instance().intern("summary-only");
+    stats[1].oncpu_ns = 1; stats[1].switches = 1; stats[1].involuntary = 1;
+
+    TraceWriter w;
+    if (!w.open(path)) return 1;
+    w.on_begin(1000, evs.front().timestamp);
+    w.append(EventSpan(evs));
+    w.set_summary(stats);
+    if (!w.close()) {
+        fprintf(stderr, "FAIL: writing %s\n", path);
+        return 1;
+    }
+
+    int failed = 0;
+    TraceReader r;
+    if (!r.open(path)) {
+        fprintf(stderr, "FAIL: reading %s\n", path);
+        return 1;
+    }
+    if (r.root_pid() != 1000 || r.origin_ns() != evs.front().timestamp || !r.has_summary() ||
+        r.event_count() != n || r.chunk_count() != 3) {
+        fprintf(stderr, "FAIL: header: root %u, origin %llu, %llu events in %zu chunks\n",
+                r.root_pid(), (unsigned long long)r.origin_ns(),
+                (unsigned long long)r.event_count(), r.chunk_count());
+        failed = 1;
+    }
+
+    std::vector<Event> back = r.read_all();
+    if (back.size() != n) {
+        fprintf(stderr, "FAIL: read %zu events of %zu\n", back.size(), n);
+        failed = 1;
+    }
+    for (size_t i = 0; i < back.size() && i < n; ++i) {
+        if (!same(back[i], evs[i])) {
+            fprintf(stderr, "FAIL: event %zu differs (%s pid %u ts %llu)\n", i,
+                    event_kind_name(evs[i].kind), evs[i].pid,
+                    (unsigned long long)evs[i].timestamp);
+            failed = 1;
+            break;
+        }
+    }
+
+    const auto& sum = r.summary();
+    for (size_t i = 0; i < stats.size(); ++i) {
+        if (sum.size() != stats.size() || sum[i].tid != stats[i].tid ||
+            sum[i].cpu != stats[i].cpu || sum[i].comm != stats[i].comm ||
+            sum[i].oncpu_ns != stats[i].oncpu_ns || sum[i].switches != stats[i].switches ||
+            sum[i].voluntary != stats[i].voluntary || sum[i].involuntary != stats[i].involuntary) {
+            fprintf(stderr, "FAIL: runtime summary entry %zu differs\n", i);
+            failed = 1;
+            break;
+        }
+    }
+
+    // the index: the middle chunk alone covers its own time range, and
+    // names every pid it holds
+    std::vector<Event> mid;
+    r.read_chunk(1, mid);
+    auto in = r.chunks_in(mid[100].timestamp, mid[200].timestamp);
+    if (in.size() != 1 || in[0] != 1) {
+        fprintf(stderr, "FAIL: chunks_in picked %zu chunks\n", in.size());
+        failed = 1;
+    }
+    for (const auto& e : mid) {
+        if (!r.chunk_may_contain(1, e.pid) || !r.chunk_may_contain(1, e.tid)) {
+            fprintf(stderr, "FAIL: chunk 1 index misses pid %u\n", e.pid);
+            failed = 1;
+            break;
+        }
+    }
+    if (r.chunk_may_contain(1, 999) || r.chunk_may_contain(1, 7000)) {
+        fprintf(stderr, "FAIL: chunk 1 index claims pids outside its range\n");
+        failed = 1;
+    }
+    r.close();
+
+    // a trace cut short has no trailer and is refused
+    {
+        std::ifstream in_f(path, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(in_f)), std::istreambuf_iterator<char>());
+        std::ofstream out_f(path, std::ios::binary | std::ios::trunc);
+        out_f.write(bytes.data(), bytes.size() - 10);
+    }
+    fprintf(stderr, "expect a truncated trace error:\n");
+    if (r.open(path)) {
+        fprintf(stderr, "FAIL: truncated trace accepted\n");
+        failed = 1;
+    }
+    std::remove(path);
+
+    if (!failed) printf("trace: %zu events round trip\n", n);
+    return failed;
+}